@@ -0,0 +1,145 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "boot_cache.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "config.h"
+#include "logging.h"
+#include "machine.h"
+#include "state.h"
+
+namespace chico {
+
+constexpr uint32_t kBootCacheMagic = 0x43424843u;  // "CHBC"
+constexpr uint32_t kBootCacheVersion = 2;
+
+struct BootCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t key;
+    uint32_t size;
+    uint32_t reserved;
+};
+
+// Writes the bytes to a new file and flushes them to the disk.
+static bool WriteFileSynced(const std::string& path, const std::vector<uint8_t>& buffer) {
+    const int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    const uint8_t* data = buffer.data();
+    size_t size = buffer.size();
+    while (size > 0) {
+        const ssize_t result = write(fd, data, size);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(fd);
+            return false;
+        }
+        data += result;
+        size -= size_t(result);
+    }
+    if (fsync(fd) < 0) {
+        close(fd);
+        return false;
+    }
+    return close(fd) == 0;
+}
+
+BootCache::BootCache(const Config& config, const std::string& path)
+    :   config_(config),
+        path_(path),
+        key_(ComputeKey()) {}
+
+void BootCache::Boot(Machine* machine, FrameBuffer* frame_buffer) {
+    if (Load(machine)) {
+        return;
+    }
+    if (!machine->RunUntilReady(frame_buffer, Machine::kMaxBootFrames)) {
+        Log(Warning) << "READY prompt not reached in " << Machine::kMaxBootFrames << " frames";
+        return;
+    }
+    Save(*machine);
+}
+
+uint64_t BootCache::ComputeKey() const {
+    const int video[] = {
+        config_.GetTotalLines(),
+        config_.GetVisibleLines(),
+        config_.GetCyclesPerLine(),
+        config_.GetVisiblePixels(),
+        config_.GetCpuClock(),
+        config_.IsFastBoot() ? 1 : 0
+    };
+    uint64_t key = HashBytes(config_.GetBasicRom(), 8192);
+    key = HashBytes(config_.GetKernalRom(), 8192, key);
+    key = HashBytes(config_.GetCharRom(), 4096, key);
+    return HashBytes(video, sizeof(video), key);
+}
+
+bool BootCache::Load(Machine* machine) {
+    std::ifstream is(path_, std::ios_base::in | std::ios_base::binary);
+    if (is.fail()) {
+        return false;
+    }
+    BootCacheHeader header;
+    is.read(reinterpret_cast<char*>(&header), sizeof(header));
+    if (is.fail() || header.magic != kBootCacheMagic || header.version != kBootCacheVersion ||
+        header.key != key_) {
+        Log(Info) << "boot cache " << path_ << " is out of date";
+        return false;
+    }
+    std::vector<uint8_t> state(header.size);
+    is.read(reinterpret_cast<char*>(state.data()), header.size);
+    if (is.fail() || !machine->LoadState(state.data(), int(state.size()))) {
+        Log(Warning) << "can't load boot cache " << path_;
+        machine->Reset();
+        return false;
+    }
+    return true;
+}
+
+// Writes a temporary file and renames it over the cache, so a job reading the cache while another
+// one updates it gets either the old or the new file, never a mix of them. The temporary file is
+// per process, the jobs sharing the cache may update it at the same time.
+void BootCache::Save(const Machine& machine) {
+    const int state_size = machine.GetStateSize();
+    const BootCacheHeader header = {kBootCacheMagic, kBootCacheVersion, key_, uint32_t(state_size), 0};
+    std::vector<uint8_t> buffer(sizeof(header) + state_size);
+    memcpy(buffer.data(), &header, sizeof(header));
+    machine.SaveState(buffer.data() + sizeof(header));
+    const std::string temp_path = path_ + ".tmp." + std::to_string(getpid());
+    if (!WriteFileSynced(temp_path, buffer) || rename(temp_path.c_str(), path_.c_str()) != 0) {
+        Log(Warning) << "can't write boot cache " << path_ << ": " << strerror(errno);
+        unlink(temp_path.c_str());
+    }
+}
+
+}  // namespace chico
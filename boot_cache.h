@@ -0,0 +1,54 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CHICO_BOOT_CACHE_H
+#define CHICO_BOOT_CACHE_H
+
+#include <cstdint>
+#include <string>
+
+namespace chico {
+
+class Config;
+class FrameBuffer;
+class Machine;
+
+// Snapshot of the machine at the READY prompt, stored in a file. The snapshot is keyed by the
+// ROM images and the video configuration, a snapshot with a different key is booted again.
+class BootCache final {
+public:
+    BootCache(const Config& config, const std::string& path);
+
+    // Restores the machine from the cache if possible, otherwise boots it and updates the cache.
+    // The machine must be reset already.
+    void Boot(Machine* machine, FrameBuffer* frame_buffer);
+
+private:
+    const Config& config_;
+    const std::string path_;
+    const uint64_t key_;
+
+    uint64_t ComputeKey() const;
+    bool Load(Machine* machine);
+    void Save(const Machine& machine);
+};
+
+}  // namespace chico
+
+#endif  // CHICO_BOOT_CACHE_H
@@ -19,10 +19,14 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "bus.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "cia_1.h"
 #include "cia_2.h"
 #include "cpu.h"
 #include "sid.h"
+#include "state.h"
 #include "vic_ii.h"
 
 namespace chico {
@@ -36,7 +40,63 @@ Bus::Bus(Cia1* cia1, Cia2* cia2, Cpu* cpu, Sid* sid, VicII* vic,
         vic_(vic),
         basic_rom_(basic_rom),
         kernal_rom_(kernal_rom),
-        char_rom_(char_rom) {}
+        char_rom_(char_rom),
+        cpu_bank_(7),
+        vic_bank_(0),
+        color_ram_{} {
+    for (int page = 0; page < kCharRomPageCount; page++) {
+        char_rom_pages_[page] = char_rom_ + page * Ram::kPageSize;
+    }
+    UpdateVicPages();
+}
+
+Bus::Bus(Bus* parent, Cia1* cia1, Cia2* cia2, Cpu* cpu, Sid* sid, VicII* vic)
+    :   cia1_(cia1),
+        cia2_(cia2),
+        cpu_(cpu),
+        sid_(sid),
+        vic_(vic),
+        basic_rom_(parent->basic_rom_),
+        kernal_rom_(parent->kernal_rom_),
+        char_rom_(parent->char_rom_),
+        cpu_bank_(parent->cpu_bank_),
+        vic_bank_(parent->vic_bank_),
+        ram_(&parent->ram_) {
+    memcpy(color_ram_, parent->color_ram_, sizeof(color_ram_));
+    for (int page = 0; page < kCharRomPageCount; page++) {
+        char_rom_pages_[page] = char_rom_ + page * Ram::kPageSize;
+    }
+    UpdateVicPages();
+}
+
+void Bus::SharePages(PageStore* store) {
+    store->Add(&ram_);
+}
+
+void Bus::SaveState(StateWriter* writer) const {
+    writer->Write(cpu_bank_);
+    writer->Write(vic_bank_);
+}
+
+void Bus::LoadState(StateReader* reader) {
+    reader->Read(&cpu_bank_);
+    reader->Read(&vic_bank_);
+    UpdateVicPages();
+}
+
+void Bus::SaveMemory(uint8_t* ram, uint8_t* color_ram) const {
+    for (int page = 0; page < Ram::kPageCount; page++) {
+        memcpy(ram + page * Ram::kPageSize, ram_.GetPage(page), Ram::kPageSize);
+    }
+    memcpy(color_ram, color_ram_, sizeof(color_ram_));
+}
+
+void Bus::LoadMemory(const uint8_t* ram, const uint8_t* color_ram) {
+    for (int page = 0; page < Ram::kPageCount; page++) {
+        ram_.SetPage(page, ram + page * Ram::kPageSize);
+    }
+    memcpy(color_ram_, color_ram, sizeof(color_ram_));
+}
 
 void Bus::Nmi() {
     cpu_->Nmi();
@@ -46,8 +106,47 @@ void Bus::SetIrq(bool value) {
     cpu_->SetIrqSignal(value);
 }
 
+void Bus::SetVicBank(int vic_bank) {
+    if (vic_bank != vic_bank_) {
+        vic_->Sync();
+        vic_bank_ = vic_bank;
+        UpdateVicPages();
+    }
+}
+
+// The char ROM shadows the RAM at $1000 and $9000 for the VIC.
+void Bus::UpdateVicPages() {
+    const uint8_t* const* ram_pages = ram_.GetPageData();
+    for (int page = 0; page < kVicPageCount; page++) {
+        const int ea = (vic_bank_ << 14u) | (page << 8u);
+        if (kVicReadTable[ea >> 12][vic_bank_] == &Bus::ReadCharRom) {
+            vic_pages_[page] = &char_rom_pages_[page & (kCharRomPageCount - 1)];
+        } else {
+            vic_pages_[page] = &ram_pages[ea >> 8];
+        }
+    }
+}
+
+void Bus::VicReadBytes(uint16_t address, uint8_t* data, int size) {
+    while (size > 0) {
+        const int offset = address & 0xffu;
+        const int count = std::min(size, Ram::kPageSize - offset);
+        memcpy(data, *vic_pages_[(address >> 8u) & 0x3fu] + offset, count);
+        address += count;
+        data += count;
+        size -= count;
+    }
+}
+
+void Bus::VicReadColors(uint16_t address, uint8_t* data, int size) {
+    const uint8_t* colors = color_ram_ + (address & 0x03ffu);
+    for (int i = 0; i < size; i++) {
+        data[i] = colors[i] & 0x0fu;
+    }
+}
+
 uint8_t Bus::ReadRam(uint16_t address) {
-    return ram_[address];
+    return ram_.Read(address);
 }
 
 uint8_t Bus::ReadBasicRom(uint16_t address) {
@@ -95,7 +194,11 @@ uint8_t Bus::ReadIo2(uint16_t) {
 }
 
 void Bus::WriteRam(uint16_t address, uint8_t data) {
-    ram_[address] = data;
+    // The glyphs, bitmaps and sprites of the VIC bank are fetched while rendering.
+    if ((address >> 14u) == vic_bank_) {
+        vic_->Sync();
+    }
+    ram_.Write(address, data);
 }
 
 void Bus::WriteIo(uint16_t address, uint8_t data) {
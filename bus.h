@@ -22,9 +22,14 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include <cstdint>
 
+#include "ram.h"
+
 namespace chico {
 
 class Cia1;
+class PageStore;
+class StateReader;
+class StateWriter;
 class Cia2;
 class Cpu;
 class Sid;
@@ -32,8 +37,12 @@ class VicII;
 
 class Bus final {
 public:
+    static constexpr int kColorRamSize = 1024;
+
     Bus(Cia1* cia1, Cia2* cia2, Cpu* cpu, Sid* sid, VicII* vic,
         const uint8_t* basic_rom, const uint8_t* kernal_rom, const uint8_t* char_rom);
+    // Creates a bus with the state of the parent, RAM pages are shared copy-on-write.
+    Bus(Bus* parent, Cia1* cia1, Cia2* cia2, Cpu* cpu, Sid* sid, VicII* vic);
 
     void CpuWrite(uint16_t address, uint8_t data) {
         (this->*kCpuWriteTable[address >> 12u][cpu_bank_])(address, data);
@@ -43,19 +52,31 @@ public:
         return (this->*kCpuReadTable[address >> 12u][cpu_bank_])(address);
     }
 
+    // The VIC reads through the page pointers of its bank, see SetVicBank.
     uint8_t VicRead(uint16_t address) {
-        const uint16_t ea = (vic_bank_ << 14u) | (address & 0x3fffu);
-        return (this->*kVicReadTable[ea >> 12][vic_bank_])(address);
+        return (*vic_pages_[(address >> 8u) & 0x3fu])[address & 0xffu];
     }
 
     uint8_t VicReadColor(uint16_t address) {
         return color_ram_[address & 0x03ffu] & 0x0fu;
     }
 
+    // Bulk versions of the VIC reads. The range must not cross a 1K boundary.
+    void VicReadBytes(uint16_t address, uint8_t* data, int size);
+    void VicReadColors(uint16_t address, uint8_t* data, int size);
+
     void Nmi();
     void SetIrq(bool value);
 
     constexpr void SetCpuBank(uint8_t cpu_bank) { cpu_bank_ = cpu_bank; }
+    void SetVicBank(int vic_bank);
+    const Ram& GetRam() const { return ram_; }
+    void SharePages(PageStore* store);
+
+    void SaveState(StateWriter* writer) const;
+    void LoadState(StateReader* reader);
+    void SaveMemory(uint8_t* ram, uint8_t* color_ram) const;
+    void LoadMemory(const uint8_t* ram, const uint8_t* color_ram);
 
 private:
     using ReadFunction = uint8_t (Bus::*)(uint16_t address);
@@ -66,6 +87,8 @@ private:
     static const ReadFunction kIoReadTable[16];
     static const WriteFunction kIoWriteTable[16];
     static const ReadFunction kVicReadTable[16][4];
+    static constexpr int kVicPageCount = 64;
+    static constexpr int kCharRomPageCount = 16;
 
     Cia1* cia1_;
     Cia2* cia2_;
@@ -77,9 +100,14 @@ private:
     const uint8_t* char_rom_;
     int cpu_bank_;
     int vic_bank_;
-    uint8_t ram_[65536];
-    uint8_t color_ram_[1024];
-
+    Ram ram_;
+    uint8_t color_ram_[kColorRamSize];
+    const uint8_t* char_rom_pages_[kCharRomPageCount];
+    // Pointers to the RAM or char ROM page pointers of the 16K VIC bank, so the VIC follows the
+    // copy-on-write page changes without updating them.
+    const uint8_t* const* vic_pages_[kVicPageCount];
+
+    void UpdateVicPages();
     uint8_t ReadRam(uint16_t address);
     uint8_t ReadBasicRom(uint16_t address);
     uint8_t ReadKernalRom(uint16_t address);
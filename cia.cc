@@ -20,6 +20,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include "cia.h"
 
 #include "logging.h"
+#include "state.h"
 
 namespace chico {
 
@@ -43,10 +44,20 @@ constexpr uint8_t kTODIN        = (1u << 7u);
 constexpr uint8_t kALARM        = (1u << 7u);
 
 void Cia::Reset() {
+    port_a_out_ = 0;
+    port_a_direction_ = 0;
+    port_b_out_ = 0;
+    port_b_direction_ = 0;
+    timer_counter_a_ = 0xffffu;
+    timer_latch_a_ = 0xffffu;
+    timer_counter_b_ = 0xffffu;
+    timer_latch_b_ = 0xffffu;
     irq_state_ = 0;
     irq_mask_ = 0;
     cra_ = 0;
     crb_ = 0;
+    WritePortA(port_a_direction_ & port_a_out_);
+    WritePortB(port_b_direction_ & port_b_out_);
 }
 
 void Cia::UpdateTimers(int elapsed_cycles) {
@@ -65,6 +76,36 @@ void Cia::UpdateTimers(int elapsed_cycles) {
     }
 }
 
+void Cia::SaveState(StateWriter* writer) const {
+    writer->Write(port_a_out_);
+    writer->Write(port_a_direction_);
+    writer->Write(port_b_out_);
+    writer->Write(port_b_direction_);
+    writer->Write(timer_counter_a_);
+    writer->Write(timer_latch_a_);
+    writer->Write(timer_counter_b_);
+    writer->Write(timer_latch_b_);
+    writer->Write(irq_state_);
+    writer->Write(irq_mask_);
+    writer->Write(cra_);
+    writer->Write(crb_);
+}
+
+void Cia::LoadState(StateReader* reader) {
+    reader->Read(&port_a_out_);
+    reader->Read(&port_a_direction_);
+    reader->Read(&port_b_out_);
+    reader->Read(&port_b_direction_);
+    reader->Read(&timer_counter_a_);
+    reader->Read(&timer_latch_a_);
+    reader->Read(&timer_counter_b_);
+    reader->Read(&timer_latch_b_);
+    reader->Read(&irq_state_);
+    reader->Read(&irq_mask_);
+    reader->Read(&cra_);
+    reader->Read(&crb_);
+}
+
 void Cia::UpdateClock(int fps) {
     // TODO(gyorgy): Implement it.
 }
@@ -195,10 +236,12 @@ void Cia::WritePrb(uint8_t data) {
 
 void Cia::WriteDdra(uint8_t data) {
     port_a_direction_ = data;
+    WritePortA(port_a_direction_ & port_a_out_);
 }
 
 void Cia::WriteDdrb(uint8_t data) {
     port_b_direction_ = data;
+    WritePortB(port_b_direction_ & port_b_out_);
 }
 
 void Cia::WriteTaLo(uint8_t data) {
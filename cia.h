@@ -24,6 +24,9 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 namespace chico {
 
+class StateReader;
+class StateWriter;
+
 class Cia {
 public:
     virtual ~Cia() = default;
@@ -39,6 +42,9 @@ public:
     void UpdateTimers(int elapsed_cycles);
     void UpdateClock(int fps);
 
+    void SaveState(StateWriter* writer) const;
+    void LoadState(StateReader* reader);
+
 protected:
     uint8_t port_a_out_;
     uint8_t port_a_direction_;
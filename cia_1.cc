@@ -28,6 +28,12 @@ Cia1::Cia1(Bus *bus, Keyboard* keyboard)
     :   bus_(bus),
         keyboard_(keyboard) {}
 
+Cia1::Cia1(Bus* bus, Keyboard* keyboard, const Cia1& other)
+    :   Cia1(other) {
+    bus_ = bus;
+    keyboard_ = keyboard;
+}
+
 void Cia1::UpdateIrqLine(bool state) {
     bus_->SetIrq(state);
 }
@@ -30,6 +30,7 @@ class Keyboard;
 class Cia1 final : public Cia {
 public:
     Cia1(Bus* bus, Keyboard* keyboard);
+    Cia1(Bus* bus, Keyboard* keyboard, const Cia1& other);
 
 protected:
     void UpdateIrqLine(bool state) override;
@@ -26,6 +26,11 @@ namespace chico {
 Cia2::Cia2(Bus *bus)
     :   bus_(bus) {}
 
+Cia2::Cia2(Bus* bus, const Cia2& other)
+    :   Cia2(other) {
+    bus_ = bus;
+}
+
 void Cia2::UpdateIrqLine(bool state) {
     if (state) {
         bus_->Nmi();
@@ -43,7 +48,9 @@ uint8_t Cia2::ReadPortB() {
 }
 
 void Cia2::WritePortA(uint8_t data) {
-    // TODO(gyorgy): Implement it.
+    // Bits 0-1 select the VIC bank inverted, the input lines are pulled up.
+    const uint8_t lines = data | ~port_a_direction_;
+    bus_->SetVicBank(~lines & 0x03u);
 }
 
 void Cia2::WritePortB(uint8_t data) {
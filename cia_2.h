@@ -29,6 +29,7 @@ class Bus;
 class Cia2 final : public Cia {
 public:
     Cia2(Bus* bus);
+    Cia2(Bus* bus, const Cia2& other);
 
 protected:
     void UpdateIrqLine(bool state) override;
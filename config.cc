@@ -19,6 +19,9 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "config.h"
 
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
 #include <fstream>
 #include <iostream>
 
@@ -29,7 +32,29 @@ namespace chico {
 Config::Config()
     :   basic_rom_(nullptr),
         kernal_rom_(nullptr),
-        char_rom_(nullptr) {}
+        char_rom_(nullptr),
+        fast_boot_(false),
+        checkpoint_interval_(3000),
+        rewind_budget_(16),
+        run_ahead_(0),
+        warp_(false),
+        warp_skip_(0),
+        vsync_(false),
+        netplay_port_(0),
+        netplay_peer_port_(0),
+        frames_(500),
+        raster_threads_(0) {}
+
+// Parses the non-negative decimal value of an option, a missing or malformed value is fatal.
+static int ParseCount(const std::string& name, const std::string& value) {
+    char* end = nullptr;
+    errno = 0;
+    const long count = std::strtol(value.c_str(), &end, 10);
+    if (value.empty() || *end != '\0' || errno == ERANGE || count < 0 || count > INT_MAX) {
+        Log(Fatal) << "expected a non-negative number for " << name << ", got '" << value << "'";
+    }
+    return int(count);
+}
 
 Config::~Config() {
     delete [] char_rom_;
@@ -37,6 +62,64 @@ Config::~Config() {
     delete [] basic_rom_;
 }
 
+void Config::ParseArguments(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        const std::string argument = argv[i];
+        const std::string::size_type separator = argument.find('=');
+        const std::string name = argument.substr(0, separator);
+        const std::string value = separator == std::string::npos ? "" : argument.substr(separator + 1);
+        if (name == "--fast-boot") {
+            fast_boot_ = true;
+        } else if (name == "--boot-cache") {
+            boot_cache_ = value;
+        } else if (name == "--checkpoint") {
+            checkpoint_ = value;
+        } else if (name == "--checkpoint-interval") {
+            checkpoint_interval_ = ParseCount(name, value);
+        } else if (name == "--frames") {
+            frames_ = ParseCount(name, value);
+        } else if (name == "--output") {
+            output_ = value;
+        } else if (name == "--netplay") {
+            const std::string::size_type colon = value.find(':');
+            if (colon == std::string::npos) {
+                Log(Fatal) << "expected --netplay=<local port>:<remote port>";
+            }
+            netplay_port_ = ParseCount(name, value.substr(0, colon));
+            netplay_peer_port_ = ParseCount(name, value.substr(colon + 1));
+        } else if (name == "--raster-threads") {
+            raster_threads_ = ParseCount(name, value);
+        } else if (name == "--record") {
+            record_ = value;
+        } else if (name == "--replay") {
+            replay_ = value;
+        } else if (name == "--rewind") {
+            rewind_budget_ = ParseCount(name, value);
+        } else if (name == "--run-ahead") {
+            run_ahead_ = ParseCount(name, value);
+        } else if (name == "--warp") {
+            warp_ = true;
+        } else if (name == "--warp-skip") {
+            warp_skip_ = ParseCount(name, value);
+        } else if (name == "--vsync") {
+            vsync_ = true;
+        } else if (name == "--zygote") {
+            zygote_socket_ = value;
+        } else {
+            Log(Fatal) << "unknown argument: " << argument;
+        }
+    }
+    // The forked children of the zygote would inherit the rasterizer without its threads.
+    if (raster_threads_ > 0 && !zygote_socket_.empty()) {
+        Log(Fatal) << "--raster-threads can't be used with --zygote";
+    }
+    // Netplay applies the inputs of both players on the frames it confirms, the recorder never sees
+    // them.
+    if (!record_.empty() && netplay_port_ > 0) {
+        Log(Fatal) << "--record can't be used with --netplay";
+    }
+}
+
 void Config::Load() {
     basic_rom_ = LoadImage("c64_roms/basic.rom", 8192);
     kernal_rom_ = LoadImage("c64_roms/kernal.rom", 8192);
@@ -21,6 +21,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #define CHICO_CONFIG_H
 
 #include <cstdint>
+#include <string>
 
 namespace chico {
 
@@ -39,7 +40,25 @@ public:
     constexpr int GetScreenMagnification() const { return screen_magnification_; }
     constexpr int GetCpuClock() const { return cpu_clock_; }
     constexpr int GetFps() const { return fps_; }
+    constexpr bool IsFastBoot() const { return fast_boot_; }
+    const std::string& GetZygoteSocket() const { return zygote_socket_; }
+    const std::string& GetBootCache() const { return boot_cache_; }
+    const std::string& GetCheckpoint() const { return checkpoint_; }
+    constexpr int GetCheckpointInterval() const { return checkpoint_interval_; }
+    constexpr int GetRewindBudget() const { return rewind_budget_; }
+    constexpr int GetRunAhead() const { return run_ahead_; }
+    constexpr bool IsWarp() const { return warp_; }
+    constexpr int GetWarpSkip() const { return warp_skip_; }
+    constexpr bool IsVsync() const { return vsync_; }
+    constexpr int GetNetplayPort() const { return netplay_port_; }
+    constexpr int GetNetplayPeerPort() const { return netplay_peer_port_; }
+    const std::string& GetRecord() const { return record_; }
+    const std::string& GetReplay() const { return replay_; }
+    constexpr int GetFrames() const { return frames_; }
+    constexpr int GetRasterThreads() const { return raster_threads_; }
+    const std::string& GetOutput() const { return output_; }
 
+    void ParseArguments(int argc, char** argv);
     void Load();
 
 private:
@@ -53,6 +72,23 @@ private:
     int screen_magnification_;
     int cpu_clock_;
     int fps_;
+    bool fast_boot_;
+    int checkpoint_interval_;
+    int rewind_budget_;
+    int run_ahead_;
+    bool warp_;
+    int warp_skip_;
+    bool vsync_;
+    int netplay_port_;
+    int netplay_peer_port_;
+    int frames_;
+    int raster_threads_;
+    std::string zygote_socket_;
+    std::string boot_cache_;
+    std::string checkpoint_;
+    std::string record_;
+    std::string replay_;
+    std::string output_;
 
     const uint8_t* LoadImage(const char* file_name, int size);
 };
@@ -21,6 +21,7 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "bus.h"
 #include "logging.h"
+#include "state.h"
 
 namespace chico {
 
@@ -29,6 +30,10 @@ constexpr uint16_t kResetVector = 0xfffcu;
 constexpr uint16_t kIrqVector   = 0xfffeu;
 constexpr uint16_t kStackBase = 0x0100u;
 
+// KERNAL RAMTAS, the memory test called on the cold start path.
+constexpr uint16_t kRamtasAddress = 0xfd50u;
+constexpr int kNoTrap = -1;
+
 constexpr uint8_t kFlagC = 0x01u;
 constexpr uint8_t kFlagZ = 0x02u;
 constexpr uint8_t kFlagI = 0x04u;
@@ -42,7 +47,22 @@ constexpr uint8_t kIrqSignal = 0x01u;
 constexpr uint8_t kNmiSignal = 0x02u;
 
 Cpu::Cpu(Bus* bus)
-    :   bus_(bus) {}
+    :   bus_(bus),
+        a_(0),
+        x_(0),
+        y_(0),
+        s_(0),
+        p_(0),
+        pc_(0),
+        port_{0, 0},
+        irq_signals_(0),
+        penalty_cycles_(0),
+        trap_address_(kNoTrap) {}
+
+Cpu::Cpu(Bus* bus, const Cpu& other)
+    :   Cpu(other) {
+    bus_ = bus;
+}
 
 void Cpu::UpdateFlagC(uint8_t value) {
     p_ = (p_ & ~kFlagC) | (value & kFlagC);
@@ -116,6 +136,36 @@ void Cpu::Reset() {
     irq_signals_ = 0;
 }
 
+void Cpu::EnableFastBoot() {
+    trap_address_ = kRamtasAddress;
+}
+
+// Leaves the memory in the state RAMTAS would, without testing 40K RAM byte by byte.
+int Cpu::RunRamtasTrap() {
+    trap_address_ = kNoTrap;
+    for (uint16_t address = 0x0002u; address < 0x0102u; address++) {
+        Write8(address, 0);
+    }
+    for (uint16_t address = 0x0200u; address < 0x0400u; address++) {
+        Write8(address, 0);
+    }
+    // Tape buffer at $033c.
+    Write8(0x00b2u, 0x3cu);
+    Write8(0x00b3u, 0x03u);
+    // The test stops at the BASIC ROM.
+    Write8(0x00c1u, 0x00u);
+    Write8(0x00c2u, 0xa0u);
+    // Top and bottom of the BASIC memory, screen memory page.
+    Write8(0x0283u, 0x00u);
+    Write8(0x0284u, 0xa0u);
+    Write8(0x0282u, 0x08u);
+    Write8(0x0288u, 0x04u);
+    x_ = 0x00u;
+    y_ = 0xa0u;
+    InstRts();
+    return 6;
+}
+
 
 int Cpu::CycleOne() {
     int done_cycles;
@@ -135,6 +185,9 @@ int Cpu::CycleOne() {
             return 7;
         }
     }
+    if (pc_ == trap_address_) {
+        return RunRamtasTrap();
+    }
     const uint8_t opcode = Read8(pc_);
     pc_ += 1u;
     penalty_cycles_ = 0;
@@ -153,6 +206,31 @@ void Cpu::SetIrqSignal(bool value) {
     }
 }
 
+void Cpu::SaveState(StateWriter* writer) const {
+    writer->Write(a_);
+    writer->Write(x_);
+    writer->Write(y_);
+    writer->Write(s_);
+    writer->Write(p_);
+    writer->Write(pc_);
+    writer->Write(port_);
+    writer->Write(irq_signals_);
+    writer->Write(penalty_cycles_);
+    writer->Write(trap_address_);
+}
+
+void Cpu::LoadState(StateReader* reader) {
+    reader->Read(&a_);
+    reader->Read(&x_);
+    reader->Read(&y_);
+    reader->Read(&s_);
+    reader->Read(&p_);
+    reader->Read(&pc_);
+    reader->Read(&port_);
+    reader->Read(&irq_signals_);
+    reader->Read(&penalty_cycles_);
+    reader->Read(&trap_address_);
+}
 
 uint16_t Cpu::AddrAbs() {
     const uint16_t ea = Read16(pc_);
@@ -25,16 +25,26 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 namespace chico {
 
 class Bus;
+class StateReader;
+class StateWriter;
 
 class Cpu final {
 public:
     Cpu(Bus* bus);
+    Cpu(Bus* bus, const Cpu& other);
+
+    constexpr uint16_t GetPc() const { return pc_; }
 
     void Reset();
+    // Skips the KERNAL RAM test of the next cold start.
+    void EnableFastBoot();
     int CycleOne();
     void Nmi();
     void SetIrqSignal(bool value);
 
+    void SaveState(StateWriter* writer) const;
+    void LoadState(StateReader* reader);
+
 private:
     using Opcode = int (Cpu::*)();
 
@@ -50,6 +60,7 @@ private:
     uint8_t port_[2];
     uint8_t irq_signals_;
     int penalty_cycles_;
+    int trap_address_;
 
     void UpdateFlagC(uint8_t value);
     void UpdateFlagZ(uint8_t value);
@@ -63,6 +74,7 @@ private:
     void Push16(uint16_t data);
     uint8_t Pop8();
     uint16_t Pop16();
+    int RunRamtasTrap();
 
     uint16_t AddrAbs();
     uint16_t AddrAbx();
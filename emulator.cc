@@ -19,16 +19,114 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "emulator.h"
 
+#include "boot_cache.h"
 #include "config.h"
+#include "logging.h"
 #include "machine.h"
+#include "movie.h"
+#include "netplay.h"
+#include "pixel_kernels.h"
+#include "rewind.h"
+#include "snapshot_file.h"
 
 namespace chico {
 
-static const uint32_t kPalette[16] = {
-    0x00000000u, 0xFFFFFF00u, 0x68372B00u, 0x70A4B200u,
-    0x6F3D8600u, 0x588D4300u, 0x35287900u, 0xB8C76F00u,
-    0x6F4F2500u, 0x43390000u, 0x9A675900u, 0x44444400u,
-    0x6C6C6C00u, 0x9AD28400u, 0x6C5EB500u, 0x95959500u,
+// Interval of the frames presented in warp mode without --warp-skip.
+constexpr uint32_t kWarpPresentTicks = 20;
+// Version of the texture lines before the first upload, no frame buffer line has it.
+constexpr uint64_t kNoLineVersion = ~uint64_t(0);
+
+/*
+POUND
+CLEAR/HOME
+UP
+RUN/STOP
+*/
+
+// Host keys of the C64 keys, by SDL scancode.
+static const struct {
+    int scancode;
+    int c64_key;
+} kKeyMappings[] = {
+    { SDL_SCANCODE_BACKSPACE, Keyboard::kDelete },
+    { SDL_SCANCODE_RETURN, Keyboard::kReturn },
+    { SDL_SCANCODE_LEFT, Keyboard::kLeftRight },
+    { SDL_SCANCODE_RIGHT, Keyboard::kLeftRight },
+    { SDL_SCANCODE_F7, Keyboard::kF7 },
+    { SDL_SCANCODE_F1, Keyboard::kF1 },
+    { SDL_SCANCODE_F3, Keyboard::kF3 },
+    { SDL_SCANCODE_F5, Keyboard::kF5 },
+    { SDL_SCANCODE_UP, Keyboard::kUpDown },
+    { SDL_SCANCODE_DOWN, Keyboard::kUpDown },
+    { SDL_SCANCODE_3, Keyboard::k3 },
+    { SDL_SCANCODE_W, Keyboard::kW },
+    { SDL_SCANCODE_A, Keyboard::kA },
+    { SDL_SCANCODE_4, Keyboard::k4 },
+    { SDL_SCANCODE_Z, Keyboard::kZ },
+    { SDL_SCANCODE_S, Keyboard::kS },
+    { SDL_SCANCODE_E, Keyboard::kE },
+    { SDL_SCANCODE_LSHIFT, Keyboard::kLeftShift },
+    { SDL_SCANCODE_5, Keyboard::k5 },
+    { SDL_SCANCODE_R, Keyboard::kR },
+    { SDL_SCANCODE_D, Keyboard::kD },
+    { SDL_SCANCODE_6, Keyboard::k6 },
+    { SDL_SCANCODE_C, Keyboard::kC },
+    { SDL_SCANCODE_F, Keyboard::kF },
+    { SDL_SCANCODE_T, Keyboard::kT },
+    { SDL_SCANCODE_X, Keyboard::kX },
+    { SDL_SCANCODE_7, Keyboard::k7 },
+    { SDL_SCANCODE_Y, Keyboard::kY },
+    { SDL_SCANCODE_G, Keyboard::kG },
+    { SDL_SCANCODE_8, Keyboard::k8 },
+    { SDL_SCANCODE_B, Keyboard::kB },
+    { SDL_SCANCODE_H, Keyboard::kH },
+    { SDL_SCANCODE_U, Keyboard::kU },
+    { SDL_SCANCODE_V, Keyboard::kV },
+    { SDL_SCANCODE_9, Keyboard::k9 },
+    { SDL_SCANCODE_I, Keyboard::kI },
+    { SDL_SCANCODE_J, Keyboard::kJ },
+    { SDL_SCANCODE_0, Keyboard::k0 },
+    { SDL_SCANCODE_M, Keyboard::kM },
+    { SDL_SCANCODE_K, Keyboard::kK },
+    { SDL_SCANCODE_O, Keyboard::kO },
+    { SDL_SCANCODE_N, Keyboard::kN },
+    { SDL_SCANCODE_MINUS, Keyboard::kPlus },
+    { SDL_SCANCODE_P, Keyboard::kP },
+    { SDL_SCANCODE_L, Keyboard::kL },
+    { SDL_SCANCODE_EQUALS, Keyboard::kMinus },
+    { SDL_SCANCODE_PERIOD, Keyboard::kPeriod },
+    { SDL_SCANCODE_SEMICOLON, Keyboard::kColon },
+    { SDL_SCANCODE_LEFTBRACKET, Keyboard::kAt },
+    { SDL_SCANCODE_COMMA, Keyboard::kComma },
+    { 0, Keyboard::kPound },
+    { SDL_SCANCODE_RIGHTBRACKET, Keyboard::kAsterisk },
+    { SDL_SCANCODE_APOSTROPHE, Keyboard::kSemicolon },
+    { 0, Keyboard::kClearHome },
+    { SDL_SCANCODE_RSHIFT, Keyboard::kRightShift },
+    { SDL_SCANCODE_BACKSLASH, Keyboard::kEqual },
+    { 0, Keyboard::kUp },
+    { SDL_SCANCODE_SLASH, Keyboard::kSlash },
+    { SDL_SCANCODE_1, Keyboard::k1 },
+    { SDL_SCANCODE_ESCAPE, Keyboard::kLeft },
+    { SDL_SCANCODE_TAB, Keyboard::kControl },
+    { SDL_SCANCODE_2, Keyboard::k2 },
+    { SDL_SCANCODE_SPACE, Keyboard::kSpace },
+    { SDL_SCANCODE_COMPUTER, Keyboard::kCommodore },
+    { SDL_SCANCODE_Q, Keyboard::kQ },
+    { 0, Keyboard::kRunStop },
+    { -2, Keyboard::kLastKey }
+};
+
+// The numeric keypad drives the joystick in port 2.
+static const struct {
+    SDL_Scancode scancode;
+    uint8_t direction;
+} kJoystickKeys[] = {
+    { SDL_SCANCODE_KP_8, Keyboard::kJoystickUp },
+    { SDL_SCANCODE_KP_2, Keyboard::kJoystickDown },
+    { SDL_SCANCODE_KP_4, Keyboard::kJoystickLeft },
+    { SDL_SCANCODE_KP_6, Keyboard::kJoystickRight },
+    { SDL_SCANCODE_KP_0, Keyboard::kJoystickFire },
 };
 
 Emulator::Emulator(const Config& config, Machine* machine)
@@ -37,8 +135,15 @@ Emulator::Emulator(const Config& config, Machine* machine)
         window_(nullptr),
         renderer_(nullptr),
         texture_(nullptr),
-        start_tick_(0),
-        ticks_per_frame_(0) {}
+        needs_present_(true),
+        frame_event_(0),
+        frame_count_(0),
+        rewinding_(false),
+        joystick_(0),
+        warp_(config.IsWarp()),
+        emulated_frames_(0),
+        present_tick_(0),
+        running_(false) {}
 
 Emulator::~Emulator() {
     SDL_DestroyTexture(texture_);
@@ -49,6 +154,7 @@ Emulator::~Emulator() {
 
 void Emulator::PowerUp() {
     SDL_Init(SDL_INIT_VIDEO | SDL_INIT_EVENTS);
+    frame_event_ = SDL_RegisterEvents(1);
     const int width = config_.GetVisiblePixels();
     const int height = config_.GetVisibleLines();
     const int magnification = config_.GetScreenMagnification();
@@ -58,25 +164,87 @@ void Emulator::PowerUp() {
                                width * magnification,
                                height * magnification,
                                0);
-    renderer_ = SDL_CreateRenderer(window_, -1, 0);
+    renderer_ = SDL_CreateRenderer(window_, -1, config_.IsVsync() ? SDL_RENDERER_PRESENTVSYNC : 0);
     texture_ = SDL_CreateTexture(renderer_,
                                  SDL_PIXELFORMAT_RGBX8888,
                                  // SDL_PIXELFORMAT_INDEX8,
                                  SDL_TEXTUREACCESS_STREAMING,
                                  width,
                                  height);
+    texture_versions_.assign(height, kNoLineVersion);
+    texture_pixels_.resize(width * height);
+    Log(Info) << "pixel kernel " << GetPixelKernelName();
     const int cycles_per_frame = config_.GetTotalLines() * config_.GetCyclesPerLine();
-    const double frames_per_second = double(config_.GetCpuClock()) / double(cycles_per_frame);
-    ticks_per_frame_ = int(1000.0 / frames_per_second);
-    frame_buffer_.Reset(width, height);
+    pacer_.Reset(cycles_per_frame, config_.GetCpuClock());
+    frames_.Reset(width, height);
     machine_->Reset();
+    run_ahead_state_.resize(machine_->GetStateSize());
+    // Stepping back would break the cycle order of a recording and the lockstep of netplay.
+    if (config_.GetRewindBudget() > 0 && config_.GetRecord().empty() &&
+        config_.GetNetplayPort() == 0) {
+        rewind_.reset(new Rewind(machine_->GetStateSize(), config_.GetRewindBudget() << 20));
+    }
+    const std::string& checkpoint = config_.GetCheckpoint();
+    if (!checkpoint.empty()) {
+        checkpoint_writer_.reset(new SnapshotWriter(checkpoint, machine_->GetStateSize()));
+        if (LoadSnapshotFile(checkpoint, machine_)) {
+            return;
+        }
+    }
+    if (!config_.GetBootCache().empty()) {
+        BootCache boot_cache(config_, config_.GetBootCache());
+        boot_cache.Boot(machine_, frames_.GetBack());
+    }
 }
 
 void Emulator::Run() {
-    while(PumpMessages()) {
-        EmulateFrame();
-        DisplayFrame();
-        Throttle();
+    if (!config_.GetRecord().empty()) {
+        recorder_.reset(new MovieRecorder(config_.GetRecord(), *machine_));
+    }
+    if (config_.GetNetplayPort() > 0) {
+        const int port = config_.GetNetplayPort();
+        const int peer_port = config_.GetNetplayPeerPort();
+        netplay_transport_.reset(new UdpTransport(port, peer_port));
+        netplay_.reset(new Netplay(machine_, netplay_transport_.get(), port < peer_port ? 0 : 1));
+    }
+    running_ = true;
+    emulation_thread_ = std::thread(&Emulator::RunEmulation, this);
+    // Sleeps until the next event. The emulation thread sends frame_event_ after publishing a
+    // frame, an event sent before the wait is still queued and ends it at once.
+    while (PumpMessages()) {
+        const FrameBuffer* frame_buffer = frames_.Acquire();
+        if (frame_buffer != nullptr) {
+            DisplayFrame(*frame_buffer);
+        } else if (needs_present_) {
+            Present();
+        }
+        SDL_WaitEvent(nullptr);
+    }
+    running_ = false;
+    emulation_thread_.join();
+}
+
+// Runs on the emulation thread, which owns the machine and the emulation state. The keys arrive
+// from the presentation thread through key_events_, and the presented frames go back in frames_.
+void Emulator::RunEmulation() {
+    while (running_) {
+        KeyEvent key_event;
+        while (key_events_.Pop(&key_event)) {
+            OnKey(key_event.scancode, key_event.pressed);
+        }
+        const bool present = IsPresentFrame();
+        if (EmulateFrame(present ? frames_.GetBack() : nullptr)) {
+            emulated_frames_ += 1;
+            if (present) {
+                frames_.Publish();
+                SDL_Event event = {};
+                event.type = frame_event_;
+                SDL_PushEvent(&event);
+            }
+        }
+        if (!warp_) {
+            pacer_.WaitFrame();
+        }
     }
 }
 
@@ -86,46 +254,157 @@ bool Emulator::PumpMessages() {
         switch (event.type) {
             case SDL_QUIT:
                 return false;
-            case SDL_KEYDOWN:
-                machine_->GetKeyboard()->OnKeyDown(event.key.keysym.scancode);
+            case SDL_WINDOWEVENT:
+                if (event.window.event == SDL_WINDOWEVENT_EXPOSED) {
+                    needs_present_ = true;
+                }
                 break;
+            case SDL_KEYDOWN:
             case SDL_KEYUP:
-                machine_->GetKeyboard()->OnKeyUp(event.key.keysym.scancode);
+                if (!event.key.repeat &&
+                    !key_events_.Push({event.key.keysym.scancode, event.type == SDL_KEYDOWN})) {
+                    Log(Warning) << "key event dropped";
+                }
                 break;
         }
     }
     return true;
 }
 
-void Emulator::EmulateFrame() {
-    machine_->RunFrame(&frame_buffer_);
+void Emulator::OnKey(int scancode, bool pressed) {
+    if (scancode == SDL_SCANCODE_F12) {
+        rewinding_ = pressed;
+        return;
+    }
+    if (scancode == SDL_SCANCODE_F11) {
+        if (pressed) {
+            warp_ = !warp_;
+        }
+        return;
+    }
+    for (const auto& key : kJoystickKeys) {
+        if (key.scancode == scancode) {
+            joystick_ = pressed ? (joystick_ | key.direction) : (joystick_ & ~key.direction);
+            ApplyInput(InputEvent::kJoystick, (1 << 8) | joystick_);
+            return;
+        }
+    }
+    for (const auto* mapping = kKeyMappings; mapping->c64_key != Keyboard::kLastKey; mapping++) {
+        if (mapping->scancode == scancode) {
+            ApplyInput(pressed ? InputEvent::kKeyDown : InputEvent::kKeyUp, mapping->c64_key);
+            return;
+        }
+    }
+}
+
+void Emulator::ApplyInput(InputEvent::Type type, int code) {
+    if (netplay_) {
+        netplay_->AddLocalInput(type, code);
+        return;
+    }
+    const InputEvent event = {machine_->GetCycles(), type, code};
+    if (recorder_) {
+        recorder_->Record(event);
+    }
+    machine_->ApplyInput(event);
+}
+
+// Warp mode runs unthrottled and presents only every --warp-skip th frame, or a frame per
+// kWarpPresentTicks. The other frames run hidden.
+bool Emulator::IsPresentFrame() {
+    if (!warp_) {
+        return true;
+    }
+    if (config_.GetWarpSkip() > 0) {
+        return emulated_frames_ % config_.GetWarpSkip() == 0;
+    }
+    const uint32_t tick = SDL_GetTicks();
+    if (tick - present_tick_ < kWarpPresentTicks) {
+        return false;
+    }
+    present_tick_ = tick;
+    return true;
+}
+
+// While F12 is held the machine steps back one frame per host frame, and the restored frame
+// is rendered again for display.
+bool Emulator::EmulateFrame(FrameBuffer* frame_buffer) {
+    if (netplay_) {
+        return netplay_->RunFrame(frame_buffer);
+    }
+    if (rewinding_ && rewind_) {
+        if (!rewind_->StepBack(machine_)) {
+            return false;
+        }
+        machine_->RunFrame(frame_buffer);
+        return true;
+    }
+    if (rewind_) {
+        rewind_->Capture(*machine_);
+    }
+    if (config_.GetRunAhead() > 0 && frame_buffer != nullptr) {
+        RunAhead(frame_buffer);
+    } else {
+        machine_->RunFrame(frame_buffer);
+    }
+    frame_count_ += 1;
+    const int checkpoint_interval = config_.GetCheckpointInterval();
+    if (checkpoint_writer_ && checkpoint_interval > 0 && frame_count_ % checkpoint_interval == 0) {
+        checkpoint_writer_->Save(*machine_);
+    }
+    return true;
+}
+
+// Runs the real frame hidden, then the frames ahead with the latest input from its end state.
+// The last frame ahead is displayed, and the machine returns to the end of the real frame.
+void Emulator::RunAhead(FrameBuffer* frame_buffer) {
+    machine_->RunFrame(nullptr);
+    machine_->SaveState(run_ahead_state_.data());
+    for (int frame = 1; frame < config_.GetRunAhead(); frame++) {
+        machine_->RunFrame(nullptr);
+    }
+    machine_->RunFrame(frame_buffer);
+    machine_->LoadState(run_ahead_state_.data(), int(run_ahead_state_.size()));
 }
 
-void Emulator::DisplayFrame() {
-    void* pixels;
-    int pitch;
-    SDL_LockTexture(texture_, NULL, &pixels, &pitch);
-    const int width = config_.GetVisiblePixels();
+// Uploads the runs of lines whose version differs from the texture, and presents the frame only
+// when something changed.
+void Emulator::DisplayFrame(const FrameBuffer& frame_buffer) {
     const int height = config_.GetVisibleLines();
-    for (int line = 0; line < height; line++) {
-        uint32_t* dest = (uint32_t*)((char*)pixels + line * pitch);
-        const uint8_t* src = frame_buffer_.line(line);
-        for (int x = 0; x < width; x++) {
-            *dest++ = kPalette[*src++ & 0x0fu];
+    bool changed = false;
+    int line = 0;
+    while (line < height) {
+        if (frame_buffer.line_version(line) == texture_versions_[line]) {
+            line += 1;
+            continue;
         }
+        const int first_line = line;
+        while (line < height && frame_buffer.line_version(line) != texture_versions_[line]) {
+            texture_versions_[line] = frame_buffer.line_version(line);
+            line += 1;
+        }
+        UploadLines(frame_buffer, first_line, line);
+        changed = true;
+    }
+    if (changed || needs_present_) {
+        Present();
     }
-    SDL_UnlockTexture(texture_);
+}
+
+void Emulator::Present() {
+    needs_present_ = false;
     SDL_RenderCopy(renderer_, texture_, NULL, NULL);
     SDL_RenderPresent(renderer_);
 }
 
-void Emulator::Throttle() {
-    const int elapsed_ticks = int(SDL_GetTicks() - start_tick_);
-    const int delay_ticks = ticks_per_frame_ - elapsed_ticks;
-    if (delay_ticks > 0) {
-        SDL_Delay(delay_ticks);
+void Emulator::UploadLines(const FrameBuffer& frame_buffer, int first_line, int end_line) {
+    const int width = config_.GetVisiblePixels();
+    uint32_t* pixels = &texture_pixels_[first_line * width];
+    for (int line = first_line; line < end_line; line++) {
+        ConvertPixels(frame_buffer.line(line), pixels + (line - first_line) * width, width);
     }
-    start_tick_ = SDL_GetTicks();
+    const SDL_Rect rect = {0, first_line, width, end_line - first_line};
+    SDL_UpdateTexture(texture_, &rect, pixels, width * int(sizeof(uint32_t)));
 }
 
 }  // namespace chico
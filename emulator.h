@@ -20,14 +20,28 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #ifndef CHICO_EMULATOR_H
 #define CHICO_EMULATOR_H
 
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
 #include <SDL2/SDL.h>
 
 #include "frame_buffer.h"
+#include "frame_pacer.h"
+#include "input.h"
+#include "spsc_queue.h"
+#include "triple_buffer.h"
 
 namespace chico {
 
 class Config;
 class Machine;
+class MovieRecorder;
+class Netplay;
+class NetplayTransport;
+class Rewind;
+class SnapshotWriter;
 
 class Emulator final {
 public:
@@ -38,19 +52,53 @@ public:
     void Run();
 
 private:
+    struct KeyEvent {
+        int scancode;
+        bool pressed;
+    };
+
     const Config& config_;
     Machine* machine_;
     SDL_Window* window_;
     SDL_Renderer* renderer_;
     SDL_Texture* texture_;
-    uint32_t start_tick_;
-    int ticks_per_frame_;
-    FrameBuffer frame_buffer_;
+    // The versions of the frame buffer lines in the texture, and the upload buffer of the lines.
+    std::vector<uint64_t> texture_versions_;
+    std::vector<uint32_t> texture_pixels_;
+    bool needs_present_;
+    // The event type pushed by the emulation thread after publishing a frame.
+    uint32_t frame_event_;
+    FramePacer pacer_;
+    TripleBuffer frames_;
+    std::unique_ptr<SnapshotWriter> checkpoint_writer_;
+    int frame_count_;
+    std::unique_ptr<Rewind> rewind_;
+    bool rewinding_;
+    std::unique_ptr<MovieRecorder> recorder_;
+    std::vector<uint8_t> run_ahead_state_;
+    std::unique_ptr<NetplayTransport> netplay_transport_;
+    std::unique_ptr<Netplay> netplay_;
+    uint8_t joystick_;
+    bool warp_;
+    // Frames run on any path, netplay and rewind included, for --warp-skip.
+    int emulated_frames_;
+    uint32_t present_tick_;
+    SpscQueue<KeyEvent, 256> key_events_;
+    std::atomic<bool> running_;
+    std::thread emulation_thread_;
 
+    void RunEmulation();
     bool PumpMessages();
-    void EmulateFrame();
-    void DisplayFrame();
-    void Throttle();
+    void OnKey(int scancode, bool pressed);
+    void ApplyInput(InputEvent::Type type, int code);
+    bool IsPresentFrame();
+    // Returns whether a frame was run, a stalled netplay or an empty rewind buffer runs none.
+    bool EmulateFrame(FrameBuffer* frame_buffer);
+    void RunAhead(FrameBuffer* frame_buffer);
+    void DisplayFrame(const FrameBuffer& frame_buffer);
+    // Presents the texture, after the frame changed or the window was exposed.
+    void Present();
+    void UploadLines(const FrameBuffer& frame_buffer, int first_line, int end_line);
 };
 
 }  // namespace chico
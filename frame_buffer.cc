@@ -22,12 +22,21 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 namespace chico {
 
+const uint32_t kPalette[16] = {
+    0x00000000u, 0xFFFFFF00u, 0x68372B00u, 0x70A4B200u,
+    0x6F3D8600u, 0x588D4300u, 0x35287900u, 0xB8C76F00u,
+    0x6F4F2500u, 0x43390000u, 0x9A675900u, 0x44444400u,
+    0x6C6C6C00u, 0x9AD28400u, 0x6C5EB500u, 0x95959500u,
+};
+
 FrameBuffer::FrameBuffer()
     :   width_(0),
         height_(0),
-        pixels_(nullptr) {}
+        pixels_(nullptr),
+        line_versions_(nullptr) {}
 
 FrameBuffer::~FrameBuffer() {
+    delete [] line_versions_;
     delete [] pixels_;
 }
 
@@ -36,10 +45,12 @@ void FrameBuffer::Reset(int width, int height) {
     assert(width <= kPitch);
     assert(height > 0);
 
+    delete [] line_versions_;
     delete [] pixels_;
     width_ = width;
     height_ = height;
     pixels_ = new uint8_t[kPitch * height];
+    line_versions_ = new uint64_t[height]();
 }
 
 }  // namespace chico
\ No newline at end of file
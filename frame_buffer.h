@@ -24,6 +24,9 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 namespace chico {
 
+// RGBX colors of the VIC-II color indexes.
+extern const uint32_t kPalette[16];
+
 class FrameBuffer final {
 public:
     FrameBuffer();
@@ -34,6 +37,10 @@ public:
     constexpr uint8_t* line(int line) { return pixels_ + line * kPitch; }
     constexpr const uint8_t* line(int line) const { return pixels_ + line * kPitch; }
     constexpr uint8_t* pixel(int x, int y) { return pixels_ + y * kPitch + x; }
+    // Lines of the same version hold the same pixels, in any frame buffer. The lines are version 0
+    // until they are rasterized, no rasterized line has version 0.
+    constexpr uint64_t* mutable_line_version(int line) { return line_versions_ + line; }
+    constexpr uint64_t line_version(int line) const { return line_versions_[line]; }
 
     void Reset(int width, int height);
 
@@ -43,6 +50,7 @@ private:
     int width_;
     int height_;
     uint8_t* pixels_;
+    uint64_t* line_versions_;
 };
 
 }  // namespace chico
@@ -0,0 +1,77 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "frame_pacer.h"
+
+#include <cerrno>
+#include <ctime>
+
+namespace chico {
+
+constexpr int64_t kNanosecondsPerSecond = 1000000000;
+
+FramePacer::FramePacer()
+    :   period_(0),
+        period_remainder_(0),
+        cpu_clock_(1),
+        remainder_(0),
+        deadline_(0) {}
+
+// The period in nanoseconds is cycles_per_frame / cpu_clock seconds, kept as an integer part and
+// a remainder in 1 / cpu_clock nanoseconds.
+void FramePacer::Reset(int cycles_per_frame, int cpu_clock) {
+    const int64_t period = int64_t(cycles_per_frame) * kNanosecondsPerSecond;
+    cpu_clock_ = cpu_clock;
+    period_ = period / cpu_clock_;
+    period_remainder_ = period % cpu_clock_;
+    remainder_ = 0;
+    deadline_ = GetTime();
+}
+
+void FramePacer::WaitFrame() {
+    deadline_ += period_;
+    remainder_ += period_remainder_;
+    if (remainder_ >= cpu_clock_) {
+        remainder_ -= cpu_clock_;
+        deadline_ += 1;
+    }
+    int64_t now = GetTime();
+    if (now - deadline_ > kMaxLagFrames * period_) {
+        deadline_ = now;
+        return;
+    }
+    if (deadline_ - now > kSpinNanoseconds) {
+        const int64_t wake_up = deadline_ - kSpinNanoseconds;
+        const timespec time = {time_t(wake_up / kNanosecondsPerSecond),
+                               long(wake_up % kNanosecondsPerSecond)};
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &time, nullptr) == EINTR) {}
+        now = GetTime();
+    }
+    while (now < deadline_) {
+        now = GetTime();
+    }
+}
+
+int64_t FramePacer::GetTime() {
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return int64_t(time.tv_sec) * kNanosecondsPerSecond + time.tv_nsec;
+}
+
+}  // namespace chico
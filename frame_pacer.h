@@ -0,0 +1,54 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CHICO_FRAME_PACER_H
+#define CHICO_FRAME_PACER_H
+
+#include <cstdint>
+
+namespace chico {
+
+// Paces the frames at the exact rate of the emulated machine. Frame deadlines are absolute and
+// advance by the exact frame period, so sleep overshoots never accumulate into drift. The sleep
+// ends kSpinNanoseconds early and the rest of the wait spins on the monotonic clock.
+class FramePacer final {
+public:
+    FramePacer();
+
+    void Reset(int cycles_per_frame, int cpu_clock);
+    // Waits for the deadline of the current frame.
+    void WaitFrame();
+
+private:
+    static constexpr int64_t kSpinNanoseconds = 1000000;
+    // Beyond this lag the pacer restarts from now instead of running the late frames unpaced.
+    static constexpr int kMaxLagFrames = 4;
+
+    int64_t period_;
+    int64_t period_remainder_;
+    int64_t cpu_clock_;
+    int64_t remainder_;
+    int64_t deadline_;
+
+    static int64_t GetTime();
+};
+
+}  // namespace chico
+
+#endif  // CHICO_FRAME_PACER_H
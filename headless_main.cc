@@ -0,0 +1,96 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include <cstdio>
+#include <vector>
+
+#include "boot_cache.h"
+#include "config.h"
+#include "logging.h"
+#include "machine.h"
+#include "movie.h"
+#include "pixel_kernels.h"
+#include "state.h"
+#include "zygote.h"
+
+// Writes the visible frame as a binary PPM image.
+static bool WriteFrame(const chico::FrameBuffer& frame_buffer, const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    fprintf(file, "P6\n%d %d\n255\n", frame_buffer.width(), frame_buffer.height());
+    std::vector<uint32_t> colors(frame_buffer.width());
+    std::vector<uint8_t> line(frame_buffer.width() * 3);
+    for (int y = 0; y < frame_buffer.height(); y++) {
+        chico::ConvertPixels(frame_buffer.line(y), colors.data(), frame_buffer.width());
+        for (int x = 0; x < frame_buffer.width(); x++) {
+            const uint32_t color = colors[x];
+            line[x * 3 + 0] = uint8_t(color >> 24u);
+            line[x * 3 + 1] = uint8_t(color >> 16u);
+            line[x * 3 + 2] = uint8_t(color >> 8u);
+        }
+        fwrite(line.data(), 1, line.size(), file);
+    }
+    return fclose(file) == 0;
+}
+
+// Runs the machine without a display: a movie replay, the zygote server, or --frames frames from
+// power on as fast as possible. Only the last frame is rendered.
+int main(int argc, char** argv) {
+    chico::Config config;
+    config.ParseArguments(argc, argv);
+    config.Load();
+    Log(Info) << "pixel kernel " << chico::GetPixelKernelName();
+    chico::Machine machine(config);
+    if (!config.GetZygoteSocket().empty()) {
+        chico::Zygote zygote(config, &machine);
+        zygote.Boot();
+        zygote.Serve(config.GetZygoteSocket().c_str());
+        return 0;
+    }
+    chico::FrameBuffer frame_buffer;
+    frame_buffer.Reset(config.GetVisiblePixels(), config.GetVisibleLines());
+    machine.Reset();
+    int frames = 0;
+    if (!config.GetReplay().empty()) {
+        chico::MoviePlayer player;
+        if (!player.Load(config.GetReplay(), &machine)) {
+            return 1;
+        }
+        frames = player.Play(&machine, &frame_buffer);
+    } else {
+        if (!config.GetBootCache().empty()) {
+            chico::BootCache boot_cache(config, config.GetBootCache());
+            boot_cache.Boot(&machine, &frame_buffer);
+        }
+        for (; frames < config.GetFrames(); frames++) {
+            machine.RunFrame(frames + 1 == config.GetFrames() ? &frame_buffer : nullptr);
+        }
+    }
+    std::vector<uint8_t> state;
+    machine.SaveState(&state);
+    Log(Info) << "ran " << frames << " frames, state hash " << std::hex
+              << chico::HashBytes(state.data(), int(state.size()));
+    if (!config.GetOutput().empty() && !WriteFrame(frame_buffer, config.GetOutput().c_str())) {
+        Log(Error) << "can't write " << config.GetOutput();
+        return 1;
+    }
+    return 0;
+}
@@ -24,30 +24,52 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 namespace chico {
 
+class StateReader;
+class StateWriter;
+
 class Keyboard final {
 public:
+    // Keys by their position in the matrix: column * 8 + row.
+    enum Key : uint8_t {
+        kDelete, kReturn,   kLeftRight, kF7,        kF1,         kF3,        kF5, kUpDown,
+        k3,      kW,        kA,         k4,         kZ,          kS,         kE,  kLeftShift,
+        k5,      kR,        kD,         k6,         kC,          kF,         kT,  kX,
+        k7,      kY,        kG,         k8,         kB,          kH,         kU,  kV,
+        k9,      kI,        kJ,         k0,         kM,          kK,         kO,  kN,
+        kPlus,   kP,        kL,         kMinus,     kPeriod,     kColon,     kAt, kComma,
+        kPound,  kAsterisk, kSemicolon, kClearHome, kRightShift, kEqual,     kUp, kSlash,
+        k1,      kLeft,     kControl,   k2,         kSpace,      kCommodore, kQ,  kRunStop,
+        kLastKey
+    };
+
+    enum : uint8_t {
+        kJoystickUp     = (1u << 0u),
+        kJoystickDown   = (1u << 1u),
+        kJoystickLeft   = (1u << 2u),
+        kJoystickRight  = (1u << 3u),
+        kJoystickFire   = (1u << 4u),
+    };
+
     Keyboard();
 
     void Reset();
     void SetColumns(uint8_t columns);
-    uint8_t GetColumns() { return columns_; }
+    uint8_t GetColumns() { return columns_ & ~joysticks_[1]; }
     void SetRows(uint8_t) {}
     uint8_t GetRows();
 
-    void OnKeyDown(int scancode);
-    void OnKeyUp(int scancode);
+    void OnKeyDown(int c64_key);
+    void OnKeyUp(int c64_key);
+    // Joysticks pull the lines of the keyboard matrix low: port 1 the rows, port 2 the columns.
+    void SetJoystick(int port, uint8_t directions);
 
-private:
-    struct Mapping {
-        int host_key_;
-        int c64_key_;
-    };
-    static const Mapping kMappings[];
+    void SaveState(StateWriter* writer) const;
+    void LoadState(StateReader* reader);
 
+private:
     uint8_t columns_;
     uint8_t rows_[8];
-
-    int FindMapping(int host_key) const;
+    uint8_t joysticks_[2];
 };
 
 
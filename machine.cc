@@ -19,10 +19,21 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "machine.h"
 
+#include <cstring>
+
 #include "config.h"
+#include "state.h"
 
 namespace chico {
 
+constexpr uint32_t kStateMagic = 0x54534843u;  // "CHST"
+constexpr uint32_t kStateVersion = 3;
+constexpr uint32_t kStateAlignment = 64;
+
+// The KERNAL polls the keyboard buffer in this loop while waiting for input.
+constexpr uint16_t kReadyLoopBegin = 0xe5cdu;
+constexpr uint16_t kReadyLoopEnd   = 0xe5d6u;
+
 Machine::Machine(const chico::Config &config)
     :   config_(config),
         bus_(&cia1_,
@@ -36,13 +47,34 @@ Machine::Machine(const chico::Config &config)
         cia1_(&bus_, &keyboard_),
         cia2_(&bus_),
         cpu_(&bus_),
-        vic_(config, &bus_) {}
+        rasterizer_(config),
+        vic_(config, &bus_, &rasterizer_) {
+    InitStateHeader();
+}
+
+Machine::Machine(Machine* parent)
+    :   config_(parent->config_),
+        bus_(&parent->bus_, &cia1_, &cia2_, &cpu_, &sid_, &vic_),
+        cia1_(&bus_, &keyboard_, parent->cia1_),
+        cia2_(&bus_, parent->cia2_),
+        cpu_(&bus_, parent->cpu_),
+        sid_(parent->sid_),
+        rasterizer_(parent->config_),
+        vic_(&bus_, &rasterizer_, parent->vic_),
+        keyboard_(parent->keyboard_),
+        overflow_cycles_(parent->overflow_cycles_),
+        cycles_(parent->cycles_),
+        state_header_(parent->state_header_) {}
 
 void Machine::Reset() {
     overflow_cycles_ = 0;
+    cycles_ = 0;
     cia1_.Reset();
     cia2_.Reset();
     cpu_.Reset();
+    if (config_.IsFastBoot()) {
+        cpu_.EnableFastBoot();
+    }
     sid_.Reset();
     vic_.Reset();
     keyboard_.Reset();
@@ -52,24 +84,183 @@ void Machine::RunFrame(FrameBuffer* frame_buffer) {
     const int cpu_cycles_per_line = config_.GetCyclesPerLine();
     const int total_lines = config_.GetTotalLines();
     for (int line = 0; line < total_lines; line++) {
-        uint8_t* line_buffer = frame_buffer->line(line);
-        vic_.BeginLine(line, line_buffer);
+        vic_.BeginLine(line, frame_buffer);
         int cpu_cycle = overflow_cycles_;
-        int vic_cycle = 0;
         while (cpu_cycle < cpu_cycles_per_line) {
             int start_cycles = cpu_cycle;
-            while (vic_cycle <= cpu_cycle) {
-                cpu_cycle += vic_.CycleOne(vic_cycle, line_buffer);
-                vic_cycle += 1;
-            }
+            cpu_cycle += vic_.TakeStalls(cpu_cycle);
+            vic_.SetCycle(cpu_cycle);
             cpu_cycle += cpu_.CycleOne();
             const int elapsed_cycles = cpu_cycle - start_cycles;
             cia1_.UpdateTimers(elapsed_cycles);
             cia2_.UpdateTimers(elapsed_cycles);
         }
+        vic_.EndLine();
         overflow_cycles_ = cpu_cycle - cpu_cycles_per_line;
     }
+    if (frame_buffer != nullptr) {
+        rasterizer_.Wait();
+    }
+    cycles_ += uint64_t(total_lines * cpu_cycles_per_line);
     // TODO(gyorgy): Update CIA real time clocks.
 }
 
+void Machine::ApplyInput(const InputEvent& event) {
+    switch (event.type) {
+        case InputEvent::kKeyDown:
+            keyboard_.OnKeyDown(event.code);
+            break;
+        case InputEvent::kKeyUp:
+            keyboard_.OnKeyUp(event.code);
+            break;
+        case InputEvent::kJoystick:
+            keyboard_.SetJoystick(event.code >> 8, uint8_t(event.code));
+            break;
+    }
+}
+
+bool Machine::RunUntilReady(FrameBuffer* frame_buffer, int max_frames) {
+    for (int frame = 0; frame < max_frames; frame++) {
+        RunFrame(frame_buffer);
+        const uint16_t pc = cpu_.GetPc();
+        if (pc >= kReadyLoopBegin && pc < kReadyLoopEnd) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Machine::SharePages(PageStore* store) {
+    bus_.SharePages(store);
+}
+
+void Machine::SaveState(uint8_t* data) const {
+    memcpy(data, &state_header_, sizeof(state_header_));
+    uint32_t end = sizeof(state_header_);
+    for (const auto& entry : state_header_.sections) {
+        memset(data + end, 0, entry.offset - end);
+        end = entry.offset + entry.size;
+    }
+    for (int section = 0; section < kStateColorRam; section++) {
+        const auto& entry = state_header_.sections[section];
+        StateWriter writer(data + entry.offset, int(entry.size));
+        SaveSection(StateSection(section), &writer);
+    }
+    bus_.SaveMemory(data + state_header_.sections[kStateRam].offset,
+                    data + state_header_.sections[kStateColorRam].offset);
+}
+
+void Machine::SaveState(std::vector<uint8_t>* buffer) const {
+    buffer->resize(state_header_.size);
+    SaveState(buffer->data());
+}
+
+bool Machine::LoadState(const uint8_t* data, int size) {
+    if (size != int(state_header_.size) ||
+        memcmp(data, &state_header_, sizeof(state_header_)) != 0) {
+        return false;
+    }
+    for (int section = 0; section < kStateColorRam; section++) {
+        const auto& entry = state_header_.sections[section];
+        StateReader reader(data + entry.offset, int(entry.size));
+        LoadSection(StateSection(section), &reader);
+    }
+    bus_.LoadMemory(data + state_header_.sections[kStateRam].offset,
+                    data + state_header_.sections[kStateColorRam].offset);
+    return true;
+}
+
+void Machine::InitStateHeader() {
+    memset(&state_header_, 0, sizeof(state_header_));
+    state_header_.magic = kStateMagic;
+    state_header_.version = kStateVersion;
+    state_header_.section_count = kStateSectionCount;
+    uint32_t offset = sizeof(StateHeader);
+    for (int section = 0; section < kStateSectionCount; section++) {
+        uint32_t size;
+        if (section == kStateRam) {
+            size = Ram::kSize;
+        } else if (section == kStateColorRam) {
+            size = Bus::kColorRamSize;
+        } else {
+            StateWriter writer(nullptr, 0);
+            SaveSection(StateSection(section), &writer);
+            size = writer.GetSize();
+        }
+        offset = (offset + kStateAlignment - 1) & ~(kStateAlignment - 1);
+        state_header_.sections[section].offset = offset;
+        state_header_.sections[section].size = size;
+        offset += size;
+    }
+    state_header_.size = offset;
+}
+
+void Machine::SaveSection(StateSection section, StateWriter* writer) const {
+    switch (section) {
+        case kStateMachine:
+            writer->Write(overflow_cycles_);
+            writer->Write(cycles_);
+            break;
+        case kStateCpu:
+            cpu_.SaveState(writer);
+            break;
+        case kStateBus:
+            bus_.SaveState(writer);
+            break;
+        case kStateCia1:
+            cia1_.SaveState(writer);
+            break;
+        case kStateCia2:
+            cia2_.SaveState(writer);
+            break;
+        case kStateVic:
+            vic_.SaveState(writer);
+            break;
+        case kStateSid:
+            sid_.SaveState(writer);
+            break;
+        case kStateKeyboard:
+            keyboard_.SaveState(writer);
+            break;
+        default:
+            break;
+    }
+}
+
+void Machine::LoadSection(StateSection section, StateReader* reader) {
+    switch (section) {
+        case kStateMachine:
+            reader->Read(&overflow_cycles_);
+            reader->Read(&cycles_);
+            break;
+        case kStateCpu:
+            cpu_.LoadState(reader);
+            break;
+        case kStateBus:
+            bus_.LoadState(reader);
+            break;
+        case kStateCia1:
+            cia1_.LoadState(reader);
+            break;
+        case kStateCia2:
+            cia2_.LoadState(reader);
+            break;
+        case kStateVic:
+            vic_.LoadState(reader);
+            break;
+        case kStateSid:
+            sid_.LoadState(reader);
+            break;
+        case kStateKeyboard:
+            keyboard_.LoadState(reader);
+            break;
+        default:
+            break;
+    }
+}
+
+std::unique_ptr<Machine> Machine::Fork() {
+    return std::unique_ptr<Machine>(new Machine(this));
+}
+
 }  // namespace chico
@@ -20,37 +20,103 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #ifndef CHICO_MACHINE_H
 #define CHICO_MACHINE_H
 
+#include <memory>
+#include <vector>
+
 #include "bus.h"
 #include "cia_1.h"
 #include "cia_2.h"
 #include "cpu.h"
+#include "input.h"
 #include "keyboard.h"
+#include "rasterizer.h"
 #include "sid.h"
 #include "vic_ii.h"
 
 namespace chico {
 
 class Config;
+class StateReader;
+class StateWriter;
 
 class Machine final {
 public:
+    // Frames the KERNAL boots in to the READY prompt, with plenty of margin.
+    static constexpr int kMaxBootFrames = 500;
+
     Machine(const Config& config);
 
     constexpr Keyboard* GetKeyboard() { return &keyboard_; }
+    // Number of CPU cycles emulated since power on, at the start of the next frame.
+    constexpr uint64_t GetCycles() const { return cycles_; }
 
     void Reset();
+    // Without a frame buffer the frame runs hidden, skipping the pixel output.
     void RunFrame(FrameBuffer* frame_buffer);
+    void ApplyInput(const InputEvent& event);
+    // Runs frames until the KERNAL waits for a key press at the READY prompt.
+    bool RunUntilReady(FrameBuffer* frame_buffer, int max_frames);
+
+    // Creates a copy of the machine. RAM pages are shared with the child until either of them
+    // writes to it, so forking costs only the pages touched later.
+    std::unique_ptr<Machine> Fork();
+    // Shares the RAM pages identical with pages of other machines added to the store.
+    void SharePages(PageStore* store);
+
+    constexpr const Bus* GetBus() const { return &bus_; }
+
+    // The state is a versioned flat image: a header with a table of fixed size sections, the
+    // device states, color RAM and RAM. It is saved at a frame boundary into GetStateSize()
+    // bytes. LoadState expects a machine already reset with the same configuration.
+    int GetStateSize() const { return int(state_header_.size); }
+    void SaveState(uint8_t* data) const;
+    void SaveState(std::vector<uint8_t>* buffer) const;
+    bool LoadState(const uint8_t* data, int size);
 
 private:
+    enum StateSection {
+        kStateMachine,
+        kStateCpu,
+        kStateBus,
+        kStateCia1,
+        kStateCia2,
+        kStateVic,
+        kStateSid,
+        kStateKeyboard,
+        kStateColorRam,
+        kStateRam,
+        kStateSectionCount
+    };
+
+    struct StateHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t size;
+        uint32_t section_count;
+        struct {
+            uint32_t offset;
+            uint32_t size;
+        } sections[kStateSectionCount];
+    };
+
+    Machine(Machine* parent);
+
+    void InitStateHeader();
+    void SaveSection(StateSection section, StateWriter* writer) const;
+    void LoadSection(StateSection section, StateReader* reader);
+
     const Config& config_;
     Bus bus_;
     Cia1 cia1_;
     Cia2 cia2_;
     Cpu cpu_;
     Sid sid_;
+    Rasterizer rasterizer_;
     VicII vic_;
     Keyboard keyboard_;
     int overflow_cycles_;
+    uint64_t cycles_;
+    StateHeader state_header_;
 };
 
 }  // namespace chico
@@ -19,10 +19,19 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "config.h"
 #include "emulator.h"
+#include "logging.h"
 #include "machine.h"
 
 int main(int argc, char** argv) {
     chico::Config config;
+    config.ParseArguments(argc, argv);
+    // Replaying a movie and serving a zygote run without a display, in chico_headless.
+    if (!config.GetReplay().empty()) {
+        Log(Fatal) << "--replay is only supported by chico_headless";
+    }
+    if (!config.GetZygoteSocket().empty()) {
+        Log(Fatal) << "--zygote is only supported by chico_headless";
+    }
     config.Load();
     chico::Machine machine(config);
     chico::Emulator emulator(config, &machine);
@@ -0,0 +1,147 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "movie.h"
+
+#include <cstring>
+#include <iterator>
+
+#include "logging.h"
+#include "machine.h"
+
+namespace chico {
+
+constexpr uint32_t kMovieMagic = 0x564d4843u;  // "CHMV"
+constexpr uint32_t kMovieVersion = 2;
+constexpr uint8_t kMovieEnd = 0xffu;
+
+struct MovieHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t state_size;
+    uint32_t reserved;
+};
+
+MovieRecorder::MovieRecorder(const std::string& path, const Machine& machine)
+    :   machine_(machine),
+        file_(path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc),
+        last_cycle_(machine.GetCycles()) {
+    std::vector<uint8_t> state;
+    machine.SaveState(&state);
+    const MovieHeader header = {kMovieMagic, kMovieVersion, uint32_t(state.size()), 0};
+    file_.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file_.write(reinterpret_cast<const char*>(state.data()), state.size());
+    if (file_.fail()) {
+        Log(Error) << "can't write movie " << path;
+    }
+}
+
+MovieRecorder::~MovieRecorder() {
+    WriteEvent(machine_.GetCycles(), kMovieEnd, 0);
+}
+
+void MovieRecorder::Record(const InputEvent& event) {
+    WriteEvent(event.cycle, event.type, event.code);
+}
+
+void MovieRecorder::WriteEvent(uint64_t cycle, uint8_t type, int code) {
+    WriteNumber(cycle - last_cycle_);
+    file_.put(char(type));
+    WriteNumber(uint64_t(code));
+    last_cycle_ = cycle;
+}
+
+void MovieRecorder::WriteNumber(uint64_t value) {
+    while (value >= 0x80u) {
+        file_.put(char((value & 0x7fu) | 0x80u));
+        value >>= 7u;
+    }
+    file_.put(char(value));
+}
+
+MoviePlayer::MoviePlayer()
+    :   end_cycle_(0) {}
+
+bool MoviePlayer::Load(const std::string& path, Machine* machine) {
+    std::ifstream is(path, std::ios_base::in | std::ios_base::binary);
+    const std::vector<uint8_t> movie((std::istreambuf_iterator<char>(is)),
+                                     std::istreambuf_iterator<char>());
+    MovieHeader header;
+    if (movie.size() < sizeof(header)) {
+        Log(Error) << "can't read movie " << path;
+        return false;
+    }
+    memcpy(&header, movie.data(), sizeof(header));
+    if (header.magic != kMovieMagic || header.version != kMovieVersion ||
+        movie.size() < sizeof(header) + header.state_size ||
+        !machine->LoadState(movie.data() + sizeof(header), int(header.state_size))) {
+        Log(Error) << "invalid movie " << path;
+        return false;
+    }
+    const uint8_t* data = movie.data() + sizeof(header) + header.state_size;
+    const uint8_t* end = movie.data() + movie.size();
+    uint64_t cycle = machine->GetCycles();
+    events_.clear();
+    for (;;) {
+        uint64_t delta;
+        uint64_t code;
+        if (!ReadNumber(&data, end, &delta) || data == end) {
+            Log(Error) << "movie " << path << " is truncated";
+            return false;
+        }
+        cycle += delta;
+        const uint8_t type = *data++;
+        if (!ReadNumber(&data, end, &code)) {
+            Log(Error) << "movie " << path << " is truncated";
+            return false;
+        }
+        if (type == kMovieEnd) {
+            end_cycle_ = cycle;
+            return true;
+        }
+        events_.push_back({cycle, InputEvent::Type(type), int(code)});
+    }
+}
+
+int MoviePlayer::Play(Machine* machine, FrameBuffer* frame_buffer) {
+    int frames = 0;
+    auto event = events_.begin();
+    while (machine->GetCycles() < end_cycle_) {
+        for (; event != events_.end() && event->cycle <= machine->GetCycles(); ++event) {
+            machine->ApplyInput(*event);
+        }
+        machine->RunFrame(frame_buffer);
+        frames += 1;
+    }
+    return frames;
+}
+
+bool MoviePlayer::ReadNumber(const uint8_t** data, const uint8_t* end, uint64_t* value) {
+    *value = 0;
+    for (int shift = 0; *data != end && shift < 64; shift += 7) {
+        const uint8_t byte = *(*data)++;
+        *value |= uint64_t(byte & 0x7fu) << uint64_t(shift);
+        if (!(byte & 0x80u)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace chico
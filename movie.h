@@ -0,0 +1,73 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CHICO_MOVIE_H
+#define CHICO_MOVIE_H
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "input.h"
+
+namespace chico {
+
+class FrameBuffer;
+class Machine;
+
+// A movie file is a header and the initial machine state, followed by the input events with
+// their cycle stamps delta encoded as variable length integers. It ends with an end marker at
+// the final cycle of the recording.
+class MovieRecorder final {
+public:
+    MovieRecorder(const std::string& path, const Machine& machine);
+    ~MovieRecorder();
+
+    void Record(const InputEvent& event);
+
+private:
+    const Machine& machine_;
+    std::ofstream file_;
+    uint64_t last_cycle_;
+
+    void WriteEvent(uint64_t cycle, uint8_t type, int code);
+    void WriteNumber(uint64_t value);
+};
+
+// Replays a movie bit exactly without the host. Events are applied at the first frame boundary
+// at or after their stamp, which is where the emulator applies the live input too.
+class MoviePlayer final {
+public:
+    MoviePlayer();
+
+    bool Load(const std::string& path, Machine* machine);
+    // Runs the machine to the end of the movie as fast as possible, returns the frames run.
+    int Play(Machine* machine, FrameBuffer* frame_buffer);
+
+private:
+    std::vector<InputEvent> events_;
+    uint64_t end_cycle_;
+
+    static bool ReadNumber(const uint8_t** data, const uint8_t* end, uint64_t* value);
+};
+
+}  // namespace chico
+
+#endif  // CHICO_MOVIE_H
@@ -0,0 +1,235 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "netplay.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "logging.h"
+#include "machine.h"
+#include "state.h"
+
+namespace chico {
+
+// Joystick port index of each player's joystick: player 0 plays in port 2, player 1 in port 1.
+constexpr int kPlayerJoystickPorts[2] = {1, 0};
+
+UdpTransport::UdpTransport(int local_port, int remote_port)
+    :   socket_(socket(AF_INET, SOCK_DGRAM, 0)),
+        remote_address_{} {
+    if (socket_ < 0) {
+        Log(Fatal) << "can't create socket: " << strerror(errno);
+    }
+    sockaddr_in local_address = {};
+    local_address.sin_family = AF_INET;
+    local_address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    local_address.sin_port = htons(uint16_t(local_port));
+    if (bind(socket_, reinterpret_cast<sockaddr*>(&local_address), sizeof(local_address)) < 0) {
+        Log(Fatal) << "can't bind port " << local_port << ": " << strerror(errno);
+    }
+    fcntl(socket_, F_SETFL, fcntl(socket_, F_GETFL) | O_NONBLOCK);
+    remote_address_.sin_family = AF_INET;
+    remote_address_.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    remote_address_.sin_port = htons(uint16_t(remote_port));
+}
+
+UdpTransport::~UdpTransport() {
+    close(socket_);
+}
+
+void UdpTransport::Send(const uint8_t* data, int size) {
+    // A lost message is sent again with the next one, so errors are not fatal.
+    sendto(socket_, data, size, 0, reinterpret_cast<const sockaddr*>(&remote_address_),
+           sizeof(remote_address_));
+}
+
+int UdpTransport::Receive(uint8_t* data, int size) {
+    for (;;) {
+        const ssize_t result = recv(socket_, data, size, 0);
+        if (result >= 0) {
+            return int(result);
+        }
+        // The peer not listening yet is reported on the next receive.
+        if (errno != ECONNREFUSED && errno != EINTR) {
+            return 0;
+        }
+    }
+}
+
+bool Netplay::FrameInput::operator==(const FrameInput& other) const {
+    if (count != other.count) {
+        return false;
+    }
+    for (int i = 0; i < count; i++) {
+        if (events[i].type != other.events[i].type || events[i].code != other.events[i].code) {
+            return false;
+        }
+    }
+    return true;
+}
+
+Netplay::Netplay(Machine* machine, NetplayTransport* transport, int player)
+    :   machine_(machine),
+        transport_(transport),
+        player_(player),
+        state_size_(machine->GetStateSize()),
+        frame_(0),
+        remote_frame_(0),
+        local_acked_(0),
+        rollback_frame_(-1),
+        pending_{},
+        frames_{},
+        states_(size_t(state_size_) * kHistoryFrames) {
+    for (Frame& frame : frames_) {
+        frame.frame = -1;
+    }
+}
+
+void Netplay::AddLocalInput(InputEvent::Type type, int code) {
+    if (pending_.count == kMaxFrameEvents) {
+        Log(Warning) << "too many inputs in frame " << frame_;
+        return;
+    }
+    pending_.events[pending_.count].type = type;
+    pending_.events[pending_.count].code = uint16_t(code);
+    pending_.count += 1;
+}
+
+bool Netplay::RunFrame(FrameBuffer* frame_buffer) {
+    ReceiveInputs();
+    if (frame_ - remote_frame_ >= kMaxPrediction || frame_ - local_acked_ >= kMaxPrediction) {
+        SendInputs();
+        return false;
+    }
+    GetSlot(frame_)->inputs[player_] = pending_;
+    pending_.count = 0;
+    if (rollback_frame_ >= 0) {
+        machine_->LoadState(&states_[size_t(rollback_frame_ % kHistoryFrames) * state_size_],
+                            state_size_);
+        for (int frame = rollback_frame_; frame < frame_; frame++) {
+            RunInputs(frame, nullptr);
+        }
+        rollback_frame_ = -1;
+    }
+    RunInputs(frame_, frame_buffer);
+    frame_ += 1;
+    SendInputs();
+    return true;
+}
+
+// Returns the history slot of the frame, reusing the slot of the frame kHistoryFrames earlier.
+Netplay::Frame* Netplay::GetSlot(int frame) {
+    Frame* slot = &frames_[frame % kHistoryFrames];
+    if (slot->frame != frame) {
+        slot->frame = frame;
+        slot->inputs[0].count = 0;
+        slot->inputs[1].count = 0;
+    }
+    return slot;
+}
+
+// Saves the state at the start of the frame, then runs it with the inputs of both players. The
+// joystick events are moved to the port of the player, whatever port the peer sent them for.
+void Netplay::RunInputs(int frame, FrameBuffer* frame_buffer) {
+    const Frame* slot = GetSlot(frame);
+    machine_->SaveState(&states_[size_t(frame % kHistoryFrames) * state_size_]);
+    for (int player = 0; player < 2; player++) {
+        const FrameInput& input = slot->inputs[player];
+        for (int i = 0; i < input.count; i++) {
+            const InputEvent::Type type = InputEvent::Type(input.events[i].type);
+            int code = input.events[i].code;
+            if (type == InputEvent::kJoystick) {
+                code = (kPlayerJoystickPorts[player] << 8) | (code & 0xff);
+            }
+            const InputEvent event = {machine_->GetCycles(), type, code};
+            machine_->ApplyInput(event);
+        }
+    }
+    machine_->RunFrame(frame_buffer);
+}
+
+void Netplay::SendInputs() {
+    uint8_t message[kMaxMessageSize];
+    StateWriter writer(message, sizeof(message));
+    writer.Write(int32_t(remote_frame_));
+    writer.Write(int32_t(local_acked_));
+    writer.Write(uint8_t(frame_ - local_acked_));
+    for (int frame = local_acked_; frame < frame_; frame++) {
+        const FrameInput& input = GetSlot(frame)->inputs[player_];
+        writer.Write(uint8_t(input.count));
+        for (int i = 0; i < input.count; i++) {
+            writer.Write(input.events[i].type);
+            writer.Write(input.events[i].code);
+        }
+    }
+    if (!writer.IsValid()) {
+        Log(Error) << "netplay message too large";
+        return;
+    }
+    transport_->Send(message, writer.GetSize());
+}
+
+void Netplay::ReceiveInputs() {
+    uint8_t message[kMaxMessageSize];
+    const int remote = player_ ^ 1;
+    for (int size; (size = transport_->Receive(message, sizeof(message))) > 0;) {
+        StateReader reader(message, size);
+        int32_t ack;
+        int32_t first_frame;
+        uint8_t frame_count;
+        reader.Read(&ack);
+        reader.Read(&first_frame);
+        reader.Read(&frame_count);
+        if (!reader.IsValid() || ack > frame_) {
+            Log(Warning) << "invalid netplay message";
+            continue;
+        }
+        local_acked_ = std::max(local_acked_, int(ack));
+        for (int frame = first_frame; frame < first_frame + frame_count; frame++) {
+            FrameInput input = {};
+            uint8_t count;
+            reader.Read(&count);
+            input.count = std::min(int(count), int(kMaxFrameEvents));
+            for (int i = 0; i < input.count; i++) {
+                reader.Read(&input.events[i].type);
+                reader.Read(&input.events[i].code);
+            }
+            // Inputs arrive in order; later frames wait to be sent again until this one is reached.
+            if (!reader.IsValid() || frame != remote_frame_ || frame > frame_) {
+                continue;
+            }
+            Frame* slot = GetSlot(frame);
+            if (frame < frame_ && !(slot->inputs[remote] == input) &&
+                (rollback_frame_ < 0 || frame < rollback_frame_)) {
+                rollback_frame_ = frame;
+            }
+            slot->inputs[remote] = input;
+            remote_frame_ += 1;
+        }
+    }
+}
+
+}  // namespace chico
@@ -0,0 +1,118 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CHICO_NETPLAY_H
+#define CHICO_NETPLAY_H
+
+#include <cstdint>
+#include <vector>
+
+#include <netinet/in.h>
+
+#include "input.h"
+
+namespace chico {
+
+class FrameBuffer;
+class Machine;
+
+// Carries the input messages between the two netplay peers. Messages may be lost.
+class NetplayTransport {
+public:
+    virtual ~NetplayTransport() = default;
+
+    virtual void Send(const uint8_t* data, int size) = 0;
+    // Returns the size of the next message received, or 0 when there is none.
+    virtual int Receive(uint8_t* data, int size) = 0;
+};
+
+// Exchanges the messages as UDP datagrams on the loopback interface.
+class UdpTransport final : public NetplayTransport {
+public:
+    UdpTransport(int local_port, int remote_port);
+    ~UdpTransport() override;
+
+    void Send(const uint8_t* data, int size) override;
+    int Receive(uint8_t* data, int size) override;
+
+private:
+    int socket_;
+    sockaddr_in remote_address_;
+};
+
+// Runs the machine in lockstep with a remote peer running the same machine. Both players' inputs
+// are applied at the start of the frame they belong to. A missing remote input is predicted to
+// change nothing; when the real one differs, the machine rolls back to the state saved at the
+// start of that frame and runs the frames again up to the present.
+//
+// Every message carries the acknowledgement of the remote inputs received, followed by all the
+// local inputs not acknowledged by the peer yet.
+class Netplay final {
+public:
+    Netplay(Machine* machine, NetplayTransport* transport, int player);
+
+    constexpr int GetFrame() const { return frame_; }
+
+    void AddLocalInput(InputEvent::Type type, int code);
+    // Runs the next frame. Returns false without running it while the remote peer is too far
+    // behind to predict its inputs.
+    bool RunFrame(FrameBuffer* frame_buffer);
+
+private:
+    static constexpr int kHistoryFrames = 16;
+    static constexpr int kMaxPrediction = kHistoryFrames - 4;
+    static constexpr int kMaxFrameEvents = 16;
+    static constexpr int kMaxMessageSize = 1024;
+
+    struct FrameInput {
+        int count;
+        struct {
+            uint8_t type;
+            uint16_t code;
+        } events[kMaxFrameEvents];
+
+        bool operator==(const FrameInput& other) const;
+    };
+
+    struct Frame {
+        int frame;
+        FrameInput inputs[2];
+    };
+
+    Machine* machine_;
+    NetplayTransport* transport_;
+    const int player_;
+    const int state_size_;
+    int frame_;
+    int remote_frame_;
+    int local_acked_;
+    int rollback_frame_;
+    FrameInput pending_;
+    Frame frames_[kHistoryFrames];
+    std::vector<uint8_t> states_;
+
+    Frame* GetSlot(int frame);
+    void RunInputs(int frame, FrameBuffer* frame_buffer);
+    void SendInputs();
+    void ReceiveInputs();
+};
+
+}  // namespace chico
+
+#endif  // CHICO_NETPLAY_H
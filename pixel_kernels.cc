@@ -0,0 +1,156 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "pixel_kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CHICO_X86_KERNELS 1
+#endif
+
+#include "frame_buffer.h"
+
+namespace chico {
+
+using ConvertFunction = void (*)(const uint8_t* indexes, uint32_t* colors, int count);
+
+struct Kernel {
+    const char* name;
+    ConvertFunction convert;
+};
+
+static void ConvertScalar(const uint8_t* indexes, uint32_t* colors, int count) {
+    for (int i = 0; i < count; i++) {
+        colors[i] = kPalette[indexes[i] & 0x0fu];
+    }
+}
+
+#ifdef CHICO_X86_KERNELS
+
+// One 16 entry table per color byte, for looking up 16 indexes at once with pshufb.
+struct PaletteBytes {
+    uint8_t bytes[4][16];
+
+    PaletteBytes() : bytes() {
+        for (int index = 0; index < 16; index++) {
+            for (int byte = 0; byte < 4; byte++) {
+                bytes[byte][index] = uint8_t(kPalette[index] >> (byte * 8u));
+            }
+        }
+    }
+};
+
+static const PaletteBytes& GetPaletteBytes() {
+    static const PaletteBytes palette_bytes;
+    return palette_bytes;
+}
+
+__attribute__((target("ssse3")))
+static void ConvertSsse3(const uint8_t* indexes, uint32_t* colors, int count) {
+    const PaletteBytes& palette = GetPaletteBytes();
+    __m128i tables[4];
+    for (int byte = 0; byte < 4; byte++) {
+        tables[byte] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(palette.bytes[byte]));
+    }
+    const __m128i low_nibbles = _mm_set1_epi8(0x0f);
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        const __m128i index = _mm_and_si128(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(indexes + i)), low_nibbles);
+        const __m128i byte_0 = _mm_shuffle_epi8(tables[0], index);
+        const __m128i byte_1 = _mm_shuffle_epi8(tables[1], index);
+        const __m128i byte_2 = _mm_shuffle_epi8(tables[2], index);
+        const __m128i byte_3 = _mm_shuffle_epi8(tables[3], index);
+        const __m128i low_01 = _mm_unpacklo_epi8(byte_0, byte_1);
+        const __m128i high_01 = _mm_unpackhi_epi8(byte_0, byte_1);
+        const __m128i low_23 = _mm_unpacklo_epi8(byte_2, byte_3);
+        const __m128i high_23 = _mm_unpackhi_epi8(byte_2, byte_3);
+        __m128i* target = reinterpret_cast<__m128i*>(colors + i);
+        _mm_storeu_si128(target + 0, _mm_unpacklo_epi16(low_01, low_23));
+        _mm_storeu_si128(target + 1, _mm_unpackhi_epi16(low_01, low_23));
+        _mm_storeu_si128(target + 2, _mm_unpacklo_epi16(high_01, high_23));
+        _mm_storeu_si128(target + 3, _mm_unpackhi_epi16(high_01, high_23));
+    }
+    ConvertScalar(indexes + i, colors + i, count - i);
+}
+
+// The 256 bit unpacks work within 128 bit lanes, the lanes are put in order before the stores.
+__attribute__((target("avx2")))
+static void ConvertAvx2(const uint8_t* indexes, uint32_t* colors, int count) {
+    const PaletteBytes& palette = GetPaletteBytes();
+    __m256i tables[4];
+    for (int byte = 0; byte < 4; byte++) {
+        tables[byte] = _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(palette.bytes[byte])));
+    }
+    const __m256i low_nibbles = _mm256_set1_epi8(0x0f);
+    int i = 0;
+    for (; i + 32 <= count; i += 32) {
+        const __m256i index = _mm256_and_si256(
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indexes + i)), low_nibbles);
+        const __m256i byte_0 = _mm256_shuffle_epi8(tables[0], index);
+        const __m256i byte_1 = _mm256_shuffle_epi8(tables[1], index);
+        const __m256i byte_2 = _mm256_shuffle_epi8(tables[2], index);
+        const __m256i byte_3 = _mm256_shuffle_epi8(tables[3], index);
+        const __m256i low_01 = _mm256_unpacklo_epi8(byte_0, byte_1);
+        const __m256i high_01 = _mm256_unpackhi_epi8(byte_0, byte_1);
+        const __m256i low_23 = _mm256_unpacklo_epi8(byte_2, byte_3);
+        const __m256i high_23 = _mm256_unpackhi_epi8(byte_2, byte_3);
+        const __m256i pixels_0 = _mm256_unpacklo_epi16(low_01, low_23);
+        const __m256i pixels_1 = _mm256_unpackhi_epi16(low_01, low_23);
+        const __m256i pixels_2 = _mm256_unpacklo_epi16(high_01, high_23);
+        const __m256i pixels_3 = _mm256_unpackhi_epi16(high_01, high_23);
+        __m256i* target = reinterpret_cast<__m256i*>(colors + i);
+        _mm256_storeu_si256(target + 0, _mm256_permute2x128_si256(pixels_0, pixels_1, 0x20));
+        _mm256_storeu_si256(target + 1, _mm256_permute2x128_si256(pixels_2, pixels_3, 0x20));
+        _mm256_storeu_si256(target + 2, _mm256_permute2x128_si256(pixels_0, pixels_1, 0x31));
+        _mm256_storeu_si256(target + 3, _mm256_permute2x128_si256(pixels_2, pixels_3, 0x31));
+    }
+    ConvertSsse3(indexes + i, colors + i, count - i);
+}
+
+#endif  // CHICO_X86_KERNELS
+
+static Kernel SelectKernel() {
+#ifdef CHICO_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return {"avx2", &ConvertAvx2};
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return {"ssse3", &ConvertSsse3};
+    }
+#endif
+    return {"scalar", &ConvertScalar};
+}
+
+static const Kernel& GetKernel() {
+    static const Kernel kernel = SelectKernel();
+    return kernel;
+}
+
+void ConvertPixels(const uint8_t* indexes, uint32_t* colors, int count) {
+    GetKernel().convert(indexes, colors, count);
+}
+
+const char* GetPixelKernelName() {
+    return GetKernel().name;
+}
+
+}  // namespace chico
@@ -0,0 +1,179 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "ram.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace chico {
+
+Ram::Ram() {
+    Page* zero_page = NewPage();
+    memset(zero_page->data, 0, kPageSize);
+    ReplacePage(0, zero_page);
+    owned_[0] = false;
+    for (int i = 1; i < kPageCount; i++) {
+        ReplacePage(i, AddReference(zero_page));
+        owned_[i] = false;
+    }
+}
+
+Ram::Ram(Ram* parent) {
+    for (int i = 0; i < kPageCount; i++) {
+        ReplacePage(i, AddReference(parent->pages_[i]));
+        owned_[i] = false;
+        parent->owned_[i] = false;
+    }
+}
+
+Ram::~Ram() {
+    for (Page* page : pages_) {
+        Release(page);
+    }
+}
+
+void Ram::SetPage(int index, const uint8_t* data) {
+    if (!owned_[index]) {
+        // Identical shared pages stay shared.
+        if (memcmp(pages_[index]->data, data, kPageSize) == 0) {
+            return;
+        }
+        Release(pages_[index]);
+        ReplacePage(index, NewPage());
+        owned_[index] = true;
+    }
+    memcpy(data_[index], data, kPageSize);
+}
+
+void Ram::ReadBytes(uint16_t address, uint8_t* data, int size) const {
+    while (size > 0) {
+        const int offset = address & 0xffu;
+        const int count = std::min(size, kPageSize - offset);
+        memcpy(data, data_[address >> 8u] + offset, count);
+        address += count;
+        data += count;
+        size -= count;
+    }
+}
+
+int Ram::GetPrivatePages() const {
+    int count = 0;
+    for (bool owned : owned_) {
+        count += owned ? 1 : 0;
+    }
+    return count;
+}
+
+void Ram::Unshare(int index) {
+    Page* page = pages_[index];
+    if (page->references.load(std::memory_order_acquire) != 1) {
+        Page* copy = NewPage();
+        memcpy(copy->data, page->data, kPageSize);
+        ReplacePage(index, copy);
+        Release(page);
+    }
+    owned_[index] = true;
+}
+
+void Ram::ReplacePage(int index, Page* page) {
+    pages_[index] = page;
+    data_[index] = page->data;
+}
+
+Ram::Page* Ram::NewPage() {
+    Page* page = new Page;
+    page->references.store(1, std::memory_order_relaxed);
+    return page;
+}
+
+Ram::Page* Ram::AddReference(Page* page) {
+    page->references.fetch_add(1, std::memory_order_relaxed);
+    return page;
+}
+
+void Ram::Release(Page* page) {
+    if (page->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        delete page;
+    }
+}
+
+PageStore::~PageStore() {
+    for (auto& entry : pages_) {
+        Ram::Release(entry.second);
+    }
+}
+
+void PageStore::Add(Ram* ram) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = 0; i < Ram::kPageCount; i++) {
+        Ram::Page* page = ram->pages_[i];
+        const uint64_t hash = Hash(page->data);
+        Ram::Page* match = nullptr;
+        const auto range = pages_.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == page || memcmp(it->second->data, page->data, Ram::kPageSize) == 0) {
+                match = it->second;
+                break;
+            }
+        }
+        if (match == nullptr) {
+            pages_.emplace(hash, Ram::AddReference(page));
+        } else if (match != page) {
+            ram->ReplacePage(i, Ram::AddReference(match));
+            Ram::Release(page);
+        }
+        ram->owned_[i] = false;
+    }
+}
+
+void PageStore::Purge() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = pages_.begin(); it != pages_.end();) {
+        if (it->second->references.load(std::memory_order_acquire) == 1) {
+            Ram::Release(it->second);
+            it = pages_.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+PageStore::Stats PageStore::GetStats() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    Stats stats = {0, 0};
+    for (auto& entry : pages_) {
+        stats.unique_pages += 1;
+        stats.references += entry.second->references.load(std::memory_order_relaxed) - 1;
+    }
+    return stats;
+}
+
+uint64_t PageStore::Hash(const uint8_t* data) {
+    uint64_t hash = 0xcbf29ce484222325u;
+    for (int i = 0; i < Ram::kPageSize; i += 8) {
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        hash = (hash ^ word) * 0x100000001b3u;
+        hash ^= hash >> 29u;
+    }
+    return hash;
+}
+
+}  // namespace chico
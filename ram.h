@@ -0,0 +1,115 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CHICO_RAM_H
+#define CHICO_RAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+namespace chico {
+
+// 64K RAM split into 256 byte pages. Pages can be shared between RAM instances, the first write
+// to a shared page makes a private copy of it.
+class Ram final {
+public:
+    static constexpr int kSize = 65536;
+    static constexpr int kPageSize = 256;
+    static constexpr int kPageCount = kSize / kPageSize;
+
+    Ram();
+    Ram(Ram* parent);
+    Ram(const Ram&) = delete;
+    Ram& operator=(const Ram&) = delete;
+    ~Ram();
+
+    uint8_t Read(uint16_t address) const {
+        return data_[address >> 8u][address & 0xffu];
+    }
+
+    void Write(uint16_t address, uint8_t data) {
+        const int index = address >> 8u;
+        if (!owned_[index]) {
+            Unshare(index);
+        }
+        data_[index][address & 0xffu] = data;
+    }
+
+    // Copies size bytes from address, page by page.
+    void ReadBytes(uint16_t address, uint8_t* data, int size) const;
+    int GetPrivatePages() const;
+    const uint8_t* GetPage(int index) const { return data_[index]; }
+    // The data pointers of the pages. The array stays in place while the pages are replaced by
+    // copy-on-write, so pointers to its entries always see the current pages.
+    const uint8_t* const* GetPageData() const { return data_; }
+    void SetPage(int index, const uint8_t* data);
+
+private:
+    friend class PageStore;
+
+    struct Page {
+        std::atomic<int> references;
+        uint8_t data[kPageSize];
+    };
+
+    Page* pages_[kPageCount];
+    uint8_t* data_[kPageCount];
+    bool owned_[kPageCount];
+
+    void Unshare(int index);
+    void ReplacePage(int index, Page* page);
+
+    static Page* NewPage();
+    static Page* AddReference(Page* page);
+    static void Release(Page* page);
+};
+
+// Content addressed store of RAM pages. Identical pages of the RAMs added to the store are
+// shared read-only between them, a write to a shared page makes a private copy of it again.
+class PageStore final {
+public:
+    struct Stats {
+        int unique_pages;
+        int references;
+    };
+
+    PageStore() = default;
+    PageStore(const PageStore&) = delete;
+    PageStore& operator=(const PageStore&) = delete;
+    ~PageStore();
+
+    // Replaces the pages of the RAM with identical pages of the store, and adds the rest of them
+    // to the store. The machine owning the RAM must not run meanwhile.
+    void Add(Ram* ram);
+    // Drops the pages not referenced by any RAM any more.
+    void Purge();
+    Stats GetStats();
+
+private:
+    std::mutex mutex_;
+    std::unordered_multimap<uint64_t, Ram::Page*> pages_;
+
+    static uint64_t Hash(const uint8_t* data);
+};
+
+}  // namespace chico
+
+#endif  // CHICO_RAM_H
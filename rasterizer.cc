@@ -0,0 +1,478 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "rasterizer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+
+#include "config.h"
+
+namespace chico {
+
+constexpr uint64_t kColorBytes = 0x0101010101010101u;
+constexpr int kLineWords = 10;
+
+// Line versions are unique across the rasterizers, as machines may render into the same frame
+// buffers.
+static std::atomic<uint64_t> next_line_version(1);
+
+// Masks of the 8 pixels of a byte, the first pixel in the lowest byte of the little endian host.
+struct PixelMasks {
+    uint64_t masks[256];
+
+    constexpr PixelMasks() : masks() {
+        for (int byte = 0; byte < 256; byte++) {
+            for (int pixel = 0; pixel < 8; pixel++) {
+                if (byte & (0x80u >> pixel)) {
+                    masks[byte] |= uint64_t(0xffu) << (pixel * 8u);
+                }
+            }
+        }
+    }
+};
+
+static constexpr PixelMasks kPixelMasks;
+
+// Masks of the 4 double wide pixels of a multicolor byte by their bit pair value.
+struct MulticolorMasks {
+    uint64_t masks[4][256];
+
+    constexpr MulticolorMasks() : masks() {
+        for (int byte = 0; byte < 256; byte++) {
+            for (int pixel = 0; pixel < 4; pixel++) {
+                const int value = (byte >> (6 - pixel * 2)) & 3;
+                masks[value][byte] |= uint64_t(0xffffu) << (pixel * 16u);
+            }
+        }
+    }
+};
+
+static constexpr MulticolorMasks kMulticolorMasks;
+
+// Reads the 64 bits of a line bitmap from pixel x, the first pixel in the highest bit.
+static inline uint64_t GetLineBits(const uint64_t* words, int x) {
+    const int word = x >> 6;
+    const int shift = x & 63;
+    if (shift == 0) {
+        return words[word];
+    }
+    return (words[word] << shift) | (words[word + 1] >> (64 - shift));
+}
+
+static inline void SetLineBits(uint64_t* words, int x, uint64_t bits) {
+    const int word = x >> 6;
+    const int shift = x & 63;
+    words[word] |= bits >> shift;
+    if (shift != 0) {
+        words[word + 1] |= bits << (64 - shift);
+    }
+}
+
+static inline uint64_t BlendMulticolor(uint8_t bits, const uint8_t colors[4]) {
+    return (kMulticolorMasks.masks[0][bits] & (kColorBytes * colors[0])) |
+           (kMulticolorMasks.masks[1][bits] & (kColorBytes * colors[1])) |
+           (kMulticolorMasks.masks[2][bits] & (kColorBytes * colors[2])) |
+           (kMulticolorMasks.masks[3][bits] & (kColorBytes * colors[3]));
+}
+
+// The pixels of a line depend only on these parts of its record. The screen bytes are not used
+// in idle state and in the vertical border.
+static bool IsSameLine(const VicLine& line, const VicLine& other) {
+    const uint8_t* registers = line.registers;
+    const uint8_t* other_registers = other.registers;
+    if (line.display != other.display || line.vertical_border != other.vertical_border ||
+        line.write_count != other.write_count || line.sprite_count != other.sprite_count ||
+        (registers[kCTRL1] ^ other_registers[kCTRL1]) & (kECM | kBMM) ||
+        (registers[kCTRL2] ^ other_registers[kCTRL2]) & (kMCM | kCSEL | 0x07u) ||
+        registers[kMxDP] != other_registers[kMxDP] ||
+        memcmp(registers + kEC, other_registers + kEC, kVicRegisterCount - kEC) != 0) {
+        return false;
+    }
+    if (line.display && !line.vertical_border &&
+        (memcmp(line.codes, other.codes, sizeof(line.codes)) != 0 ||
+         memcmp(line.colors, other.colors, sizeof(line.colors)) != 0 ||
+         memcmp(line.graphics, other.graphics, sizeof(line.graphics)) != 0)) {
+        return false;
+    }
+    return memcmp(line.writes, other.writes, line.write_count * sizeof(VicLine::Write)) == 0 &&
+           memcmp(line.sprites, other.sprites, line.sprite_count * sizeof(VicSprite)) == 0;
+}
+
+// Replays the record of a line. The pixels are rendered up to the beam position of each register
+// write before the write is applied, as if the VIC rendered them in step with the CPU.
+class LineRasterizer final {
+public:
+    LineRasterizer(const VicLine& line, int width, int min_x);
+
+    void Run();
+
+private:
+    using CellRenderer = uint64_t (LineRasterizer::*)(int cell);
+
+    static const CellRenderer kCellRenderers[8];
+
+    const VicLine& line_;
+    uint8_t* pixels_;
+    uint8_t registers_[kVicRegisterCount];
+    int width_;
+    int min_x_;
+    int x_;
+    int left_border_;
+    int right_border_;
+    int scroll_x_;
+    int next_cell_;
+    CellRenderer renderer_;
+
+    void SelectRenderer();
+    void RenderTo(int last_x);
+    void RenderScreen(int last_x);
+    void RenderCell(int cell);
+    uint64_t RenderIdle(int cell);
+    uint64_t RenderStandardText(int cell);
+    uint64_t RenderMulticolorText(int cell);
+    uint64_t RenderStandardBitmap(int cell);
+    uint64_t RenderMulticolorBitmap(int cell);
+    uint64_t RenderExtendedText(int cell);
+    uint64_t RenderInvalid(int cell);
+    void DrawSprites();
+};
+
+LineRasterizer::LineRasterizer(const VicLine& line, int width, int min_x)
+    :   line_(line),
+        pixels_(line.pixels),
+        width_(width),
+        min_x_(min_x),
+        x_(0),
+        next_cell_(0) {
+    memcpy(registers_, line.registers, sizeof(registers_));
+    const int max_x = min_x + kScreenCells * 8;
+    const uint8_t ctrl2 = registers_[kCTRL2];
+    left_border_ = (ctrl2 & kCSEL) ? min_x : min_x + 7;
+    right_border_ = (ctrl2 & kCSEL) ? max_x : max_x - 9;
+    scroll_x_ = min_x + (ctrl2 & 7);
+    SelectRenderer();
+}
+
+void LineRasterizer::Run() {
+    for (int i = 0; i < line_.write_count; i++) {
+        const VicLine::Write& write = line_.writes[i];
+        RenderTo(write.x);
+        registers_[write.address] = write.data;
+        if (write.address == kCTRL1 || write.address == kCTRL2) {
+            SelectRenderer();
+        }
+    }
+    RenderTo(width_);
+    if (line_.sprite_count != 0) {
+        DrawSprites();
+    }
+}
+
+// Picks the cell renderer of the graphics mode, at the start of the line and when the mode
+// bits change.
+void LineRasterizer::SelectRenderer() {
+    if (!line_.display) {
+        renderer_ = &LineRasterizer::RenderIdle;
+        return;
+    }
+    const int mode = ((registers_[kCTRL1] & (kECM | kBMM)) >> 4u) |
+                     ((registers_[kCTRL2] & kMCM) >> 4u);
+    renderer_ = kCellRenderers[mode];
+}
+
+void LineRasterizer::RenderTo(int last_x) {
+    if (last_x <= x_) {
+        return;
+    }
+    if (line_.vertical_border) {
+        memset(pixels_ + x_, registers_[kEC], last_x - x_);
+    } else {
+        RenderScreen(last_x);
+    }
+    x_ = last_x;
+}
+
+// Renders the pixels of the screen line from x_ up to last_x. The cells starting before last_x
+// are rendered whole, a few pixels ahead of the beam, then the border is drawn over them.
+void LineRasterizer::RenderScreen(int last_x) {
+    const uint8_t border_color = registers_[kEC];
+    const int background_x = std::max(x_, min_x_);
+    const int background_end = std::min(last_x, scroll_x_);
+    if (background_x < background_end) {
+        memset(pixels_ + background_x, registers_[kB0C] & 0x0fu, background_end - background_x);
+    }
+    while (next_cell_ < kScreenCells && scroll_x_ + next_cell_ * 8 < last_x) {
+        RenderCell(next_cell_);
+        next_cell_ += 1;
+    }
+    if (x_ < left_border_) {
+        memset(pixels_ + x_, border_color, std::min(last_x, left_border_) - x_);
+    }
+    if (last_x > right_border_) {
+        const int x = std::max(x_, right_border_);
+        memset(pixels_ + x, border_color, last_x - x);
+    }
+}
+
+void LineRasterizer::RenderCell(int cell) {
+    const uint64_t pixels = (this->*renderer_)(cell);
+    memcpy(pixels_ + scroll_x_ + cell * 8, &pixels, sizeof(pixels));
+}
+
+uint64_t LineRasterizer::RenderIdle(int) {
+    return kColorBytes * (registers_[kB0C] & 0x0fu);
+}
+
+// Expands the glyph row of the cell to 8 pixels through kPixelMasks.
+uint64_t LineRasterizer::RenderStandardText(int cell) {
+    const uint8_t bits = line_.graphics[cell];
+    const uint64_t mask = kPixelMasks.masks[bits];
+    const uint64_t foreground = kColorBytes * line_.colors[cell];
+    const uint64_t background = kColorBytes * (registers_[kB0C] & 0x0fu);
+    return (foreground & mask) | (background & ~mask);
+}
+
+// Cells with color bit 3 set are multicolor, the rest are standard text of the lower 8 colors.
+uint64_t LineRasterizer::RenderMulticolorText(int cell) {
+    const uint8_t bits = line_.graphics[cell];
+    const uint8_t color = line_.colors[cell];
+    if (!(color & 0x08u)) {
+        const uint64_t mask = kPixelMasks.masks[bits];
+        const uint64_t foreground = kColorBytes * color;
+        const uint64_t background = kColorBytes * (registers_[kB0C] & 0x0fu);
+        return (foreground & mask) | (background & ~mask);
+    }
+    const uint8_t colors[4] = {
+        uint8_t(registers_[kB0C] & 0x0fu), uint8_t(registers_[kB1C] & 0x0fu),
+        uint8_t(registers_[kB2C] & 0x0fu), uint8_t(color & 0x07u)};
+    return BlendMulticolor(bits, colors);
+}
+
+// Set bits take the upper, clear bits the lower nibble of the screen code.
+uint64_t LineRasterizer::RenderStandardBitmap(int cell) {
+    const uint8_t bits = line_.graphics[cell];
+    const uint64_t mask = kPixelMasks.masks[bits];
+    const uint64_t foreground = kColorBytes * (line_.codes[cell] >> 4u);
+    const uint64_t background = kColorBytes * (line_.codes[cell] & 0x0fu);
+    return (foreground & mask) | (background & ~mask);
+}
+
+uint64_t LineRasterizer::RenderMulticolorBitmap(int cell) {
+    const uint8_t bits = line_.graphics[cell];
+    const uint8_t colors[4] = {
+        uint8_t(registers_[kB0C] & 0x0fu), uint8_t(line_.codes[cell] >> 4u),
+        uint8_t(line_.codes[cell] & 0x0fu), line_.colors[cell]};
+    return BlendMulticolor(bits, colors);
+}
+
+// The upper 2 bits of the screen code select the background color of the 64 glyphs.
+uint64_t LineRasterizer::RenderExtendedText(int cell) {
+    const uint8_t code = line_.codes[cell];
+    const uint8_t bits = line_.graphics[cell];
+    const uint64_t mask = kPixelMasks.masks[bits];
+    const uint64_t foreground = kColorBytes * line_.colors[cell];
+    const uint64_t background = kColorBytes * (registers_[kB0C + (code >> 6u)] & 0x0fu);
+    return (foreground & mask) | (background & ~mask);
+}
+
+// ECM combined with MCM or BMM displays black.
+uint64_t LineRasterizer::RenderInvalid(int) {
+    return 0;
+}
+
+// Composites the sprites inside the display window. A sprite pixel hides the pixels of the
+// lower priority sprites even when it is behind the graphics foreground itself.
+void LineRasterizer::DrawSprites() {
+    uint64_t covered[kLineWords] = {};
+    const uint8_t colors[3] = {
+        uint8_t(registers_[kMM0] & 0x0fu), 0, uint8_t(registers_[kMM1] & 0x0fu)};
+    for (int i = 0; i < line_.sprite_count; i++) {
+        const VicSprite& sprite = line_.sprites[i];
+        if (sprite.x < 0 || sprite.x + 64 > kLineWords * 64) {
+            continue;
+        }
+        uint64_t visible = sprite.mask & ~GetLineBits(covered, sprite.x);
+        SetLineBits(covered, sprite.x, sprite.mask);
+        if (registers_[kMxDP] & (1u << sprite.index)) {
+            visible &= ~sprite.foreground;
+        }
+        const int left = left_border_ - sprite.x;
+        const int right = right_border_ - sprite.x;
+        if (left > 0) {
+            visible &= left < 64 ? ~uint64_t(0) >> left : 0;
+        }
+        if (right < 64) {
+            visible &= right > 0 ? ~(~uint64_t(0) >> right) : 0;
+        }
+
+        uint8_t plane_colors[3] = {colors[0], uint8_t(registers_[kM0C + sprite.index] & 0x0fu),
+                                   colors[2]};
+        for (int group = 0; group < 8; group++) {
+            const int shift = 56 - group * 8;
+            if (!((visible >> shift) & 0xffu)) {
+                continue;
+            }
+            uint8_t* target = pixels_ + sprite.x + group * 8;
+            uint64_t pixels;
+            memcpy(&pixels, target, sizeof(pixels));
+            for (int plane = 0; plane < 3; plane++) {
+                const uint64_t mask =
+                    kPixelMasks.masks[((sprite.planes[plane] & visible) >> shift) & 0xffu];
+                pixels = (pixels & ~mask) | (kColorBytes * plane_colors[plane] & mask);
+            }
+            memcpy(target, &pixels, sizeof(pixels));
+        }
+    }
+}
+
+const LineRasterizer::CellRenderer LineRasterizer::kCellRenderers[8] = {
+    &LineRasterizer::RenderStandardText,  // Standard text
+    &LineRasterizer::RenderMulticolorText,  // Multicolor text
+    &LineRasterizer::RenderStandardBitmap,  // Standard bitmap
+    &LineRasterizer::RenderMulticolorBitmap,  // Multicolor bitmap
+    &LineRasterizer::RenderExtendedText,  // Extended color text
+    &LineRasterizer::RenderInvalid,  // Extended color multicolor text
+    &LineRasterizer::RenderInvalid,  // Extended color bitmap
+    &LineRasterizer::RenderInvalid,  // Extended color multicolor bitmap
+};
+
+Rasterizer::Rasterizer(const Config& config)
+    :   width_(config.GetVisiblePixels()),
+        height_(config.GetVisibleLines()),
+        min_x_((width_ - kScreenCells * 8) / 2),
+        thread_count_(config.GetRasterThreads()),
+        first_pending_line_(0),
+        committed_end_line_(0),
+        busy_workers_(0),
+        stopping_(false) {}
+
+Rasterizer::~Rasterizer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_ready_.notify_all();
+    for (std::thread& worker : workers_) {
+        worker.join();
+    }
+}
+
+// The records are allocated by the first displayed frame, hidden frames don't need them.
+VicLine* Rasterizer::GetLine(int line) {
+    if (lines_.empty()) {
+        lines_.resize(height_);
+        cached_lines_.resize(height_);
+        cached_pixels_.resize(height_ * width_);
+        cached_versions_.resize(height_);
+        // No record has a negative write count, so nothing is cached yet.
+        for (VicLine& cached_line : cached_lines_) {
+            cached_line.write_count = -1;
+        }
+    }
+    return &lines_[line];
+}
+
+void Rasterizer::Commit(int line) {
+    if (thread_count_ == 0) {
+        RasterizeLine(line);
+        return;
+    }
+    committed_end_line_ = line + 1;
+    if (committed_end_line_ - first_pending_line_ >= kBandLines) {
+        Dispatch(committed_end_line_);
+    }
+}
+
+void Rasterizer::Wait() {
+    if (first_pending_line_ < committed_end_line_) {
+        Dispatch(committed_end_line_);
+    }
+    first_pending_line_ = 0;
+    committed_end_line_ = 0;
+    if (workers_.empty()) {
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex_);
+    work_done_.wait(lock, [this] { return bands_.empty() && busy_workers_ == 0; });
+}
+
+// Queues the committed lines up to end_line as a band. The workers are started by the first band,
+// so machines never displaying a frame have no threads.
+void Rasterizer::Dispatch(int end_line) {
+    if (workers_.empty()) {
+        for (int i = 0; i < thread_count_; i++) {
+            workers_.emplace_back(&Rasterizer::RunWorker, this);
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bands_.push_back({first_pending_line_, end_line});
+    }
+    work_ready_.notify_one();
+    first_pending_line_ = end_line;
+}
+
+void Rasterizer::RunWorker() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        work_ready_.wait(lock, [this] { return stopping_ || !bands_.empty(); });
+        if (bands_.empty()) {
+            return;
+        }
+        const Band band = bands_.front();
+        bands_.pop_front();
+        busy_workers_ += 1;
+        lock.unlock();
+        for (int line = band.first_line; line < band.end_line; line++) {
+            RasterizeLine(line);
+        }
+        lock.lock();
+        busy_workers_ -= 1;
+        if (bands_.empty() && busy_workers_ == 0) {
+            work_done_.notify_all();
+        }
+    }
+}
+
+// Only the thread rasterizing the line touches its cache entry. A cached line is copied unless the
+// frame buffer holds its version already, a changed record displaying the same pixels keeps the
+// version of the line.
+void Rasterizer::RasterizeLine(int line) {
+    const VicLine& record = lines_[line];
+    uint8_t* cached_pixels = &cached_pixels_[line * width_];
+    uint64_t& version = cached_versions_[line];
+    if (IsSameLine(record, cached_lines_[line])) {
+        if (*record.version != version) {
+            memcpy(record.pixels, cached_pixels, width_);
+        }
+    } else {
+        LineRasterizer rasterizer(record, width_, min_x_);
+        rasterizer.Run();
+        cached_lines_[line] = record;
+        if (version == 0 || memcmp(cached_pixels, record.pixels, width_) != 0) {
+            memcpy(cached_pixels, record.pixels, width_);
+            version = next_line_version.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    *record.version = version;
+}
+
+}  // namespace chico
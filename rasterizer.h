@@ -0,0 +1,123 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CHICO_RASTERIZER_H
+#define CHICO_RASTERIZER_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "vic_registers.h"
+
+namespace chico {
+
+class Config;
+
+// A sprite row of a line. The masks hold the pixels from the sprite's x, the first pixel in the
+// highest bit. The foreground holds the graphics foreground pixels under the sprite.
+struct VicSprite {
+    int index;
+    int x;
+    uint64_t mask;
+    uint64_t planes[3];
+    uint64_t foreground;
+};
+
+// Everything the VIC displays on a line: the registers at the start of the line, the bytes
+// fetched from memory, the register writes during the line and the sprites.
+struct VicLine {
+    // At most one write every cycle, a few more for the instruction crossing the line end.
+    static constexpr int kMaxWrites = 72;
+
+    struct Write {
+        int16_t x;
+        uint8_t address;
+        uint8_t data;
+    };
+
+    uint8_t* pixels;
+    uint64_t* version;
+    uint8_t registers[kVicRegisterCount];
+    bool display;
+    bool vertical_border;
+    uint8_t codes[kScreenCells];
+    uint8_t colors[kScreenCells];
+    uint8_t graphics[kScreenCells];
+    int write_count;
+    Write writes[kMaxWrites];
+    int sprite_count;
+    VicSprite sprites[8];
+};
+
+// Turns the line records of the VIC into pixels. With worker threads the lines are rasterized in
+// bands while the emulation of the frame goes on, otherwise right when the line is committed.
+// The pixels of each line are cached with its record, a line displayed the same way as the last
+// time is copied from the cache. The line versions of the frame buffer change only when the
+// pixels of the line do.
+class Rasterizer final {
+public:
+    explicit Rasterizer(const Config& config);
+    Rasterizer(const Rasterizer&) = delete;
+    Rasterizer& operator=(const Rasterizer&) = delete;
+    ~Rasterizer();
+
+    VicLine* GetLine(int line);
+    // The record of the line is complete, it's not touched by the VIC until the next frame.
+    void Commit(int line);
+    // Waits until the pixels of all committed lines are in the frame buffer.
+    void Wait();
+
+private:
+    static constexpr int kBandLines = 32;
+
+    struct Band {
+        int first_line;
+        int end_line;
+    };
+
+    const int width_;
+    const int height_;
+    const int min_x_;
+    const int thread_count_;
+    std::vector<VicLine> lines_;
+    std::vector<VicLine> cached_lines_;
+    std::vector<uint8_t> cached_pixels_;
+    std::vector<uint64_t> cached_versions_;
+    int first_pending_line_;
+    int committed_end_line_;
+    std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable work_done_;
+    std::deque<Band> bands_;
+    int busy_workers_;
+    bool stopping_;
+    std::vector<std::thread> workers_;
+
+    void Dispatch(int end_line);
+    void RunWorker();
+    void RasterizeLine(int line);
+};
+
+}  // namespace chico
+
+#endif  // CHICO_RASTERIZER_H
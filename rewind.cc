@@ -0,0 +1,168 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "rewind.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "machine.h"
+
+namespace chico {
+
+Rewind::Rewind(int state_size, int budget_bytes)
+    :   state_size_(state_size),
+        budget_bytes_(budget_bytes),
+        used_bytes_(0),
+        frames_since_keyframe_(0),
+        last_(state_size),
+        current_(state_size) {}
+
+void Rewind::Capture(const Machine& machine) {
+    machine.SaveState(current_.data());
+    Entry entry;
+    entry.keyframe = entries_.empty() || frames_since_keyframe_ + 1 >= kKeyframeInterval;
+    Encode(entry.keyframe ? nullptr : last_.data(), current_.data(), &entry.data);
+    entry.data.shrink_to_fit();
+    frames_since_keyframe_ = entry.keyframe ? 0 : frames_since_keyframe_ + 1;
+    used_bytes_ += entry.data.size();
+    entries_.push_back(std::move(entry));
+    last_.swap(current_);
+    Evict();
+}
+
+bool Rewind::StepBack(Machine* machine) {
+    if (entries_.empty()) {
+        return false;
+    }
+    machine->LoadState(last_.data(), state_size_);
+    const Entry& entry = entries_.back();
+    used_bytes_ -= entry.data.size();
+    if (entry.keyframe) {
+        entries_.pop_back();
+        RebuildLast();
+    } else {
+        Decode(entry.data, last_.data());
+        entries_.pop_back();
+        frames_since_keyframe_ -= 1;
+    }
+    return true;
+}
+
+// Drops the oldest keyframe with its deltas while the ring is over the budget. The newest
+// keyframe group always stays.
+void Rewind::Evict() {
+    while (used_bytes_ > budget_bytes_) {
+        const auto next_keyframe = std::find_if(entries_.begin() + 1, entries_.end(),
+                                                [](const Entry& entry) { return entry.keyframe; });
+        if (next_keyframe == entries_.end()) {
+            return;
+        }
+        for (auto it = entries_.begin(); it != next_keyframe; ++it) {
+            used_bytes_ -= it->data.size();
+        }
+        entries_.erase(entries_.begin(), next_keyframe);
+    }
+}
+
+void Rewind::RebuildLast() {
+    if (entries_.empty()) {
+        frames_since_keyframe_ = 0;
+        return;
+    }
+    auto keyframe = entries_.end() - 1;
+    while (!keyframe->keyframe) {
+        --keyframe;
+    }
+    memset(last_.data(), 0, state_size_);
+    for (auto it = keyframe; it != entries_.end(); ++it) {
+        Decode(it->data, last_.data());
+    }
+    frames_since_keyframe_ = int(entries_.end() - keyframe) - 1;
+}
+
+// The delta is a list of changed blocks: block index and encoded size as 16 bit values, then
+// the XOR of the block as pairs of zero run and literal run lengths, each followed by the literals.
+// Without a previous state the block is encoded against zeros.
+void Rewind::Encode(const uint8_t* previous, const uint8_t* current, std::vector<uint8_t>* delta) const {
+    uint8_t block[kBlockSize];
+    for (int offset = 0; offset < state_size_; offset += kBlockSize) {
+        const int size = std::min(kBlockSize, state_size_ - offset);
+        if (previous != nullptr) {
+            if (memcmp(previous + offset, current + offset, size) == 0) {
+                continue;
+            }
+            for (int i = 0; i < size; i++) {
+                block[i] = previous[offset + i] ^ current[offset + i];
+            }
+        } else {
+            memcpy(block, current + offset, size);
+        }
+        const size_t header = delta->size();
+        const uint16_t index = uint16_t(offset / kBlockSize);
+        delta->push_back(index & 0xffu);
+        delta->push_back(index >> 8u);
+        delta->push_back(0);
+        delta->push_back(0);
+        int i = 0;
+        while (i < size) {
+            int zeros = 0;
+            while (i + zeros < size && zeros < 255 && block[i + zeros] == 0) {
+                zeros += 1;
+            }
+            i += zeros;
+            int literals = 0;
+            while (i + literals < size && literals < 255 && block[i + literals] != 0) {
+                literals += 1;
+            }
+            delta->push_back(uint8_t(zeros));
+            delta->push_back(uint8_t(literals));
+            delta->insert(delta->end(), block + i, block + i + literals);
+            i += literals;
+        }
+        const size_t encoded = delta->size() - header - 4;
+        if (encoded == 2 && (*delta)[header + 5] == 0 && (*delta)[header + 4] == 0) {
+            delta->resize(header);
+            continue;
+        }
+        (*delta)[header + 2] = uint8_t(encoded & 0xffu);
+        (*delta)[header + 3] = uint8_t(encoded >> 8u);
+    }
+}
+
+void Rewind::Decode(const std::vector<uint8_t>& delta, uint8_t* state) const {
+    const uint8_t* data = delta.data();
+    const uint8_t* end = data + delta.size();
+    while (data < end) {
+        const int offset = (data[0] | (data[1] << 8u)) * kBlockSize;
+        const uint8_t* block_end = data + 4 + (data[2] | (data[3] << 8u));
+        data += 4;
+        int i = offset;
+        while (data < block_end) {
+            i += data[0];
+            const int literals = data[1];
+            data += 2;
+            for (int j = 0; j < literals; j++) {
+                state[i++] ^= *data++;
+            }
+        }
+    }
+}
+
+}  // namespace chico
@@ -0,0 +1,71 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CHICO_REWIND_H
+#define CHICO_REWIND_H
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+namespace chico {
+
+class Machine;
+
+// Ring of the recent machine states within a memory budget. Every state is stored as the XOR
+// of the changed 256 byte blocks against the previous state, run length encoded, with a
+// keyframe of the full state once in every kKeyframeInterval frames. Stepping back XORs the
+// newest delta out of the current state, or replays the deltas from the previous keyframe.
+class Rewind final {
+public:
+    Rewind(int state_size, int budget_bytes);
+
+    int GetFrames() const { return int(entries_.size()); }
+
+    void Capture(const Machine& machine);
+    // Restores the newest captured state and drops it from the ring.
+    bool StepBack(Machine* machine);
+
+private:
+    static constexpr int kKeyframeInterval = 50;
+    static constexpr int kBlockSize = 256;
+
+    struct Entry {
+        bool keyframe;
+        std::vector<uint8_t> data;
+    };
+
+    const int state_size_;
+    const size_t budget_bytes_;
+    size_t used_bytes_;
+    int frames_since_keyframe_;
+    std::deque<Entry> entries_;
+    std::vector<uint8_t> last_;
+    std::vector<uint8_t> current_;
+
+    void Evict();
+    void RebuildLast();
+    void Encode(const uint8_t* previous, const uint8_t* current, std::vector<uint8_t>* delta) const;
+    void Decode(const std::vector<uint8_t>& delta, uint8_t* state) const;
+};
+
+}  // namespace chico
+
+#endif  // CHICO_REWIND_H
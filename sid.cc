@@ -19,12 +19,15 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "sid.h"
 
+#include <cstring>
+
 #include "logging.h"
+#include "state.h"
 
 namespace chico {
 
 void Sid::Reset() {
-    // TODO(gyorgy): Implement it.
+    memset(registers_, 0, sizeof(registers_));
 }
 
 uint8_t Sid::Read(uint16_t address) const {
@@ -37,5 +40,13 @@ void Sid::Write(uint16_t address, uint8_t data) {
     registers_[address & 0x1fu] = data;
 }
 
+void Sid::SaveState(StateWriter* writer) const {
+    writer->Write(registers_);
+}
+
+void Sid::LoadState(StateReader* reader) {
+    reader->Read(&registers_);
+}
+
 
 }  // namespace chico
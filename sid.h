@@ -24,12 +24,18 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 namespace chico {
 
+class StateReader;
+class StateWriter;
+
 class Sid final {
 public:
     void Reset();
     uint8_t Read(uint16_t address) const;
     void Write(uint16_t address, uint8_t data);
 
+    void SaveState(StateWriter* writer) const;
+    void LoadState(StateReader* reader);
+
 private:
     uint8_t registers_[64];
 };
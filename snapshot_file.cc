@@ -0,0 +1,141 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "snapshot_file.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "logging.h"
+#include "machine.h"
+
+namespace chico {
+
+bool LoadSnapshotFile(const std::string& path, Machine* machine) {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) < 0 || file_stat.st_size != machine->GetStateSize()) {
+        close(fd);
+        Log(Warning) << "invalid snapshot file " << path;
+        return false;
+    }
+    void* data = mmap(nullptr, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        Log(Warning) << "can't map snapshot file " << path << ": " << strerror(errno);
+        return false;
+    }
+    const bool result = machine->LoadState(static_cast<const uint8_t*>(data), int(file_stat.st_size));
+    munmap(data, file_stat.st_size);
+    if (!result) {
+        Log(Warning) << "incompatible snapshot file " << path;
+    }
+    return result;
+}
+
+SnapshotWriter::SnapshotWriter(const std::string& path, int state_size)
+    :   path_(path),
+        buffers_{std::vector<uint8_t>(state_size), std::vector<uint8_t>(state_size)},
+        pending_buffer_(kNoBuffer),
+        writing_buffer_(kNoBuffer),
+        stopping_(false),
+        thread_(&SnapshotWriter::Run, this) {}
+
+SnapshotWriter::~SnapshotWriter() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    condition_.notify_one();
+    thread_.join();
+}
+
+void SnapshotWriter::Save(const Machine& machine) {
+    int buffer;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffer = writing_buffer_ == 0 ? 1 : 0;
+        if (pending_buffer_ == buffer) {
+            pending_buffer_ = kNoBuffer;
+        }
+    }
+    machine.SaveState(buffers_[buffer].data());
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        pending_buffer_ = buffer;
+    }
+    condition_.notify_one();
+}
+
+void SnapshotWriter::Run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+        condition_.wait(lock, [this] { return stopping_ || pending_buffer_ != kNoBuffer; });
+        if (pending_buffer_ == kNoBuffer) {
+            return;
+        }
+        writing_buffer_ = pending_buffer_;
+        pending_buffer_ = kNoBuffer;
+        lock.unlock();
+        if (!WriteFile(buffers_[writing_buffer_])) {
+            Log(Error) << "can't write snapshot file " << path_ << ": " << strerror(errno);
+        }
+        lock.lock();
+        writing_buffer_ = kNoBuffer;
+    }
+}
+
+// Writes a temporary file and renames it, so a crash never leaves a partial snapshot behind.
+bool SnapshotWriter::WriteFile(const std::vector<uint8_t>& buffer) {
+    const std::string temp_path = path_ + ".tmp";
+    const int fd = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    const uint8_t* data = buffer.data();
+    size_t size = buffer.size();
+    while (size > 0) {
+        const ssize_t result = write(fd, data, size);
+        if (result < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(fd);
+            return false;
+        }
+        data += result;
+        size -= size_t(result);
+    }
+    if (fsync(fd) < 0) {
+        close(fd);
+        return false;
+    }
+    close(fd);
+    return rename(temp_path.c_str(), path_.c_str()) == 0;
+}
+
+}  // namespace chico
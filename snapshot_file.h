@@ -0,0 +1,66 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CHICO_SNAPSHOT_FILE_H
+#define CHICO_SNAPSHOT_FILE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace chico {
+
+class Machine;
+
+// A snapshot file is the flat state image of the machine as is, so it's restored from a read-only
+// mapping of the file without parsing.
+bool LoadSnapshotFile(const std::string& path, Machine* machine);
+
+// Writes snapshot files on a background thread. The state is copied into one of two buffers on the
+// calling thread, the other one may be written to the disk meanwhile. A save requested while the
+// previous one is still pending replaces it.
+class SnapshotWriter final {
+public:
+    SnapshotWriter(const std::string& path, int state_size);
+    ~SnapshotWriter();
+
+    void Save(const Machine& machine);
+
+private:
+    static constexpr int kNoBuffer = -1;
+
+    const std::string path_;
+    std::vector<uint8_t> buffers_[2];
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    int pending_buffer_;
+    int writing_buffer_;
+    bool stopping_;
+    std::thread thread_;
+
+    void Run();
+    bool WriteFile(const std::vector<uint8_t>& buffer);
+};
+
+}  // namespace chico
+
+#endif  // CHICO_SNAPSHOT_FILE_H
@@ -0,0 +1,87 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CHICO_STATE_H
+#define CHICO_STATE_H
+
+#include <cstdint>
+#include <cstring>
+
+namespace chico {
+
+// Writes the state of the machine components into a fixed size buffer. Without a buffer the
+// writer only measures the size of the state.
+class StateWriter final {
+public:
+    StateWriter(uint8_t* data, int size) : data_(data), size_(size), written_(0) {}
+
+    constexpr int GetSize() const { return written_; }
+    constexpr bool IsValid() const { return written_ <= size_; }
+
+    template <typename T>
+    void Write(const T& value) { WriteBytes(&value, sizeof(T)); }
+    void WriteBytes(const void* data, int size) {
+        if (data_ != nullptr && written_ + size <= size_) {
+            memcpy(data_ + written_, data, size);
+        }
+        written_ += size;
+    }
+
+private:
+    uint8_t* data_;
+    int size_;
+    int written_;
+};
+
+// Reads back the state written by StateWriter. Reading past the end of the data makes the reader
+// invalid and fills the values with zeros.
+class StateReader final {
+public:
+    StateReader(const uint8_t* data, int size) : data_(data), size_(size), valid_(true) {}
+
+    constexpr bool IsValid() const { return valid_; }
+    constexpr bool IsAtEnd() const { return size_ == 0; }
+
+    template <typename T>
+    void Read(T* value) { ReadBytes(value, sizeof(T)); }
+    void ReadBytes(void* data, int size) {
+        if (size > size_) {
+            valid_ = false;
+            memset(data, 0, size);
+            return;
+        }
+        memcpy(data, data_, size);
+        data_ += size;
+        size_ -= size;
+    }
+
+private:
+    const uint8_t* data_;
+    int size_;
+    bool valid_;
+};
+
+constexpr uint64_t kHashSeed = 0xcbf29ce484222325u;
+
+// FNV-1a hash of the data.
+uint64_t HashBytes(const void* data, int size, uint64_t hash = kHashSeed);
+
+}  // namespace chico
+
+#endif  // CHICO_STATE_H
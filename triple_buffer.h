@@ -0,0 +1,53 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CHICO_TRIPLE_BUFFER_H
+#define CHICO_TRIPLE_BUFFER_H
+
+#include <atomic>
+
+#include "frame_buffer.h"
+
+namespace chico {
+
+// Hands the frames of the emulation thread to the presentation thread without locks. The
+// producer renders into the back buffer and publishes it, the consumer acquires the latest
+// published frame. Frames published while the consumer is busy replace each other.
+class TripleBuffer final {
+public:
+    TripleBuffer();
+
+    void Reset(int width, int height);
+    FrameBuffer* GetBack() { return &buffers_[back_]; }
+    void Publish();
+    // Returns the frame published latest since the previous call, or nullptr.
+    const FrameBuffer* Acquire();
+
+private:
+    static constexpr int kFresh = 4;
+
+    FrameBuffer buffers_[3];
+    int back_;
+    int front_;
+    std::atomic<int> middle_;
+};
+
+}  // namespace chico
+
+#endif  // CHICO_TRIPLE_BUFFER_H
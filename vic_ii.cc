@@ -19,78 +19,72 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "vic_ii.h"
 
+#include <algorithm>
+#include <cstring>
+
 #include "config.h"
 #include "bus.h"
 
 #include "logging.h"
+#include "state.h"
+#include "vic_registers.h"
 
 namespace chico {
 
-constexpr uint8_t kIRQ  = 0x80u;
-constexpr uint8_t kILP  = 0x08u;
-constexpr uint8_t kIMMC = 0x04u;
-constexpr uint8_t kIMBC = 0x02u;
-constexpr uint8_t kIRST = 0x01u;
-
-constexpr uint8_t kELP  = 0x80u;
-constexpr uint8_t kEMMC = 0x04u;
-constexpr uint8_t kEMBC = 0x02u;
-constexpr uint8_t kERST = 0x01u;
-
-// constexpr int kM0X      = 0x00;
-// constexpr int kM0Y      = 0x01;
-// constexpr int kM1X      = 0x02;
-// constexpr int kM1Y      = 0x03;
-// constexpr int kM2X      = 0x04;
-// constexpr int kM2Y      = 0x05;
-// constexpr int kM3X      = 0x06;
-// constexpr int kM3Y      = 0x07;
-// constexpr int kM4X      = 0x08;
-// constexpr int kM4Y      = 0x09;
-// constexpr int kM5X      = 0x0a;
-// constexpr int kM5Y      = 0x0b;
-// constexpr int kM6X      = 0x0c;
-// constexpr int kM6Y      = 0x0d;
-// constexpr int kM7X      = 0x0e;
-// constexpr int kM7Y      = 0x0f;
-// constexpr int kMxX      = 0x10;
-constexpr int kCTRL1    = 0x11;
-constexpr int kRC       = 0x12;
-// constexpr int kLPX      = 0x13;
-// constexpr int kLPY      = 0x14;
-// constexpr int kMxE      = 0x15;
-// constexpr int kCTRL2    = 0x16;
-// constexpr int kMxYE     = 0x17;
-constexpr int kMP       = 0x18;
-constexpr int kIR       = 0x19;
-constexpr int kIE       = 0x1a;
-// constexpr int kMxDP     = 0x1b;
-// constexpr int kMxMC     = 0x1c;
-// constexpr int kMxXE     = 0x1d;
-// constexpr int kMxM      = 0x1e;
-// constexpr int kMxD      = 0x1f;
-constexpr int kEC       = 0x20;
-constexpr int kB0C      = 0x21;
-// constexpr int kB1C      = 0x22;
-// constexpr int kB2C      = 0x23;
-// constexpr int kB3C      = 0x24;
-// constexpr int kMM0      = 0x25;
-// constexpr int kMM1      = 0x26;
-// constexpr int kM0C      = 0x27;
-// constexpr int kM1C      = 0x28;
-// constexpr int kM2C      = 0x29;
-// constexpr int kM3C      = 0x2a;
-// constexpr int kM4C      = 0x2b;
-// constexpr int kM5C      = 0x2c;
-// constexpr int kM6C      = 0x2d;
-// constexpr int kM7C      = 0x2e;
-
-VicII::VicII(const Config& config, Bus* bus)
+// Raster lines of the display window in the VIC's own numbering, the first text row of the
+// default vertical scroll is mapped to min_y_.
+constexpr int kFirstTextLine = 0x33;
+constexpr int kFirstBadLine = 0x30;
+constexpr int kLastBadLine = 0xf7;
+// Cycles of a bad line the CPU is stopped for, from BA going low to the last c-access.
+constexpr int kBadLineStallCycle = 11;
+constexpr int kBadLineStallCycles = 43;
+// The s-accesses of sprite 0 start at this cycle, the next sprites follow every 2 cycles and
+// wrap to the start of the line. BA goes low 3 cycles before them.
+constexpr int kSpriteDmaCycle = 57;
+constexpr int kSpriteDmaCycles = 2;
+constexpr int kBaLeadCycles = 3;
+constexpr int kNoStall = 0x7fffffff;
+
+// Each bit of a byte doubled, for X expanded sprites.
+struct ExpandMasks {
+    uint16_t masks[256];
+
+    constexpr ExpandMasks() : masks() {
+        for (int byte = 0; byte < 256; byte++) {
+            for (int bit = 0; bit < 8; bit++) {
+                if (byte & (1u << bit)) {
+                    masks[byte] |= 3u << (bit * 2u);
+                }
+            }
+        }
+    }
+};
+
+static constexpr ExpandMasks kExpandMasks;
+
+static inline uint64_t ExpandSpriteRow(uint32_t row) {
+    return (uint64_t(kExpandMasks.masks[(row >> 16u) & 0xffu]) << 32u) |
+           (uint64_t(kExpandMasks.masks[(row >> 8u) & 0xffu]) << 16u) |
+           kExpandMasks.masks[row & 0xffu];
+}
+
+VicII::VicII(const Config& config, Bus* bus, Rasterizer* rasterizer)
     :   config_(config),
         bus_(bus),
-        raster_irq_(512) {}
+        rasterizer_(rasterizer),
+        raster_irq_(512),
+        record_(nullptr) {}
+
+VicII::VicII(Bus* bus, Rasterizer* rasterizer, const VicII& other)
+    :   VicII(other) {
+    bus_ = bus;
+    rasterizer_ = rasterizer;
+    record_ = nullptr;
+}
 
 void VicII::Reset() {
+    memset(registers_, 0, sizeof(registers_));
     raster_irq_ = 512;
     visible_width_ = config_.GetVisiblePixels();
     visible_height_ = config_.GetVisibleLines();
@@ -100,72 +94,344 @@ void VicII::Reset() {
     max_y_ = min_y_ + screen_height_;
     min_x_ = (visible_width_ - screen_width_) / 2;  // min_x_ = 24;
     max_x_ = min_x_ + screen_width_;
+    memset(char_line_, 0, sizeof(char_line_));
+    memset(color_line_, 0, sizeof(color_line_));
+    char_row_ = 0;
+    UpdateBases();
+    video_base_ = 0;
+    display_ = false;
+    display_enabled_ = false;
+    vertical_border_ = true;
+    record_ = nullptr;
+    cycle_ = 0;
+    stalls_[0] = {kNoStall, 0};
+    next_stall_ = 0;
+    sprite_count_ = 0;
 }
 
-void VicII::BeginLine(int line, uint8_t* line_buffer) {
+void VicII::BeginLine(int line, FrameBuffer* frame_buffer) {
     y_ = line;
-    x_ = 0;
-    pixel_ = line_buffer;
-    registers_[kRC] = line & 0xffu;
-    if (line > 0xffu) {
+    raster_ = (line + kFirstTextLine - min_y_) % config_.GetTotalLines();
+    next_cell_ = 0;
+    cycle_ = 0;
+    registers_[kRC] = raster_ & 0xffu;
+    if (raster_ > 0xff) {
         registers_[kCTRL1] |= 0x80u;
     } else {
         registers_[kCTRL1] &= 0x7fu;
     }
-    if (line == raster_irq_) {
+    if (raster_ == raster_irq_) {
         registers_[kIR] |= kIRST;
-        if (registers_[kIR] & registers_[kIE] & 0xfu) {
-            registers_[kIR] |= kIR;
-            bus_->SetIrq(true);
-        }
+        RaiseIrq(kIRST);
+    }
+
+    const uint8_t ctrl1 = registers_[kCTRL1];
+    if (raster_ == 0) {
+        video_base_ = 0;
+        display_ = false;
+        display_enabled_ = false;
+        vertical_border_ = true;
+    }
+    if (raster_ == kFirstBadLine && (ctrl1 & kDEN)) {
+        display_enabled_ = true;
+    }
+    if (raster_ == ((ctrl1 & kRSEL) ? 0xfb : 0xf7)) {
+        vertical_border_ = true;
+    } else if (raster_ == ((ctrl1 & kRSEL) ? 0x33 : 0x37) && (ctrl1 & kDEN)) {
+        vertical_border_ = false;
     }
 
-    const int screen_y = (y_ - min_y_);
-    char_row_ = screen_y % 8;
-    if (char_row_ == 0) {
+    // The row counter wraps into idle state after the 8th line of a text row.
+    if (display_) {
+        if (char_row_ == 7) {
+            display_ = false;
+            video_base_ = (video_base_ + kScreenCells) & 0x3ffu;
+        } else {
+            char_row_ += 1;
+        }
+    }
+    const bool bad_line = display_enabled_ && raster_ >= kFirstBadLine &&
+                          raster_ <= kLastBadLine && (raster_ & 7) == (ctrl1 & 7);
+    if (bad_line) {
         // it's a bad line, read line buffers.
-        const uint16_t screen_base = (registers_[kMP] & 0xf0u) << 6u;
-        const int char_y = screen_y / 8;
-        for (int x = 0; x < 40; x++) {
-            const uint16_t char_offset = char_y * 40 + x;
-            color_line_[x] = bus_->VicReadColor(char_offset);
-            char_line_[x] = bus_->VicRead(screen_base + char_offset);
+        bus_->VicReadColors(video_base_, color_line_, kScreenCells);
+        bus_->VicReadBytes(screen_base_ + video_base_, char_line_, kScreenCells);
+        display_ = true;
+        char_row_ = 0;
+    }
+    const uint8_t ctrl2 = registers_[kCTRL2];
+    left_border_ = (ctrl2 & kCSEL) ? min_x_ : min_x_ + 7;
+    right_border_ = (ctrl2 & kCSEL) ? max_x_ : max_x_ - 9;
+    scroll_x_ = min_x_ + (ctrl2 & 7);
+    const uint8_t dma = registers_[kMxE] ? GetSpriteDma(raster_) : 0;
+    UpdateStalls(bad_line, dma);
+    LatchSprites(dma);
+
+    record_ = nullptr;
+    if (frame_buffer != nullptr && line < visible_height_) {
+        record_ = rasterizer_->GetLine(line);
+        record_->pixels = frame_buffer->line(line);
+        record_->version = frame_buffer->mutable_line_version(line);
+        memcpy(record_->registers, registers_, sizeof(record_->registers));
+        record_->display = display_;
+        record_->vertical_border = vertical_border_;
+        memcpy(record_->codes, char_line_, sizeof(record_->codes));
+        memcpy(record_->colors, color_line_, sizeof(record_->colors));
+        record_->write_count = 0;
+        record_->sprite_count = 0;
+    }
+}
+
+void VicII::EndLine() {
+    for (int i = 0; i < sprite_count_; i++) {
+        sprites_[i].foreground = GetForegroundMask(sprites_[i].x);
+    }
+    if (sprite_count_ != 0) {
+        DetectCollisions(sprites_, sprite_count_);
+    }
+    if (record_ == nullptr) {
+        return;
+    }
+    FetchTo(visible_width_);
+    if (!vertical_border_) {
+        std::copy(sprites_, sprites_ + sprite_count_, record_->sprites);
+        record_->sprite_count = sprite_count_;
+    }
+    rasterizer_->Commit(y_);
+    record_ = nullptr;
+}
+
+// Fetches the graphics bytes of the cells starting before last_x, with the mode and the memory
+// contents they are displayed with.
+void VicII::FetchTo(int last_x) {
+    if (!display_ || vertical_border_) {
+        return;
+    }
+    while (next_cell_ < kScreenCells && scroll_x_ + next_cell_ * 8 < last_x) {
+        record_->graphics[next_cell_] = FetchGraphics(next_cell_);
+        next_cell_ += 1;
+    }
+}
+
+// Logs the register value after a write, the rasterizer applies it at the beam position.
+void VicII::LogWrite(uint16_t address) {
+    if (record_->write_count < VicLine::kMaxWrites) {
+        record_->writes[record_->write_count++] = {
+            int16_t(GetBeamX()), uint8_t(address), registers_[address]};
+    }
+}
+
+void VicII::SaveState(StateWriter* writer) const {
+    writer->Write(registers_);
+    writer->Write(raster_irq_);
+    writer->Write(char_line_);
+    writer->Write(color_line_);
+    writer->Write(char_row_);
+    writer->Write(char_rom_base_);
+}
+
+void VicII::LoadState(StateReader* reader) {
+    reader->Read(&registers_);
+    reader->Read(&raster_irq_);
+    reader->Read(&char_line_);
+    reader->Read(&color_line_);
+    reader->Read(&char_row_);
+    reader->Read(&char_rom_base_);
+    UpdateBases();
+}
+
+// Collects the cycles of the line where BA is low into stall windows, merging the adjacent
+// ones. The CPU is stopped for a whole window at its first cycle.
+void VicII::UpdateStalls(bool bad_line, uint8_t dma) {
+    const int cycles_per_line = config_.GetCyclesPerLine();
+    uint64_t stolen = 0;
+    if (bad_line) {
+        stolen |= ((uint64_t(1) << kBadLineStallCycles) - 1) << kBadLineStallCycle;
+    }
+    for (int index = 0; dma >> index; index++) {
+        if (!((dma >> index) & 1u)) {
+            continue;
+        }
+        const int access = kSpriteDmaCycle + index * kSpriteDmaCycles;
+        for (int cycle = access - kBaLeadCycles; cycle < access + kSpriteDmaCycles; cycle++) {
+            stolen |= uint64_t(1) << (cycle % cycles_per_line);
         }
     }
-    char_rom_base_ = (registers_[kMP] & 0x0eu) << 10u;
+
+    int count = 0;
+    while (stolen != 0 && count < kMaxStalls) {
+        const int cycle = __builtin_ctzll(stolen);
+        const int cycles = __builtin_ctzll(~(stolen >> cycle));
+        stalls_[count++] = {cycle, cycles};
+        stolen &= ~(((uint64_t(1) << cycles) - 1) << cycle);
+    }
+    stalls_[count] = {kNoStall, 0};
+    next_stall_ = 0;
 }
 
-int VicII::CycleOne(int cycle, uint8_t* line_buffer) {
-    if (y_ >= visible_height_ || x_ >= visible_width_) {
-        return 0;
+// Returns the sprites displayed on the line, they are fetched by DMA.
+uint8_t VicII::GetSpriteDma(int vic_line) {
+    uint8_t dma = 0;
+    for (int index = 0; index < 8; index++) {
+        const uint8_t bit = 1u << index;
+        if (!(registers_[kMxE] & bit)) {
+            continue;
+        }
+        const int row = vic_line - (registers_[kM0Y + index * 2] + 1);
+        if (row >= 0 && row < ((registers_[kMxYE] & bit) ? 42 : 21)) {
+            dma |= bit;
+        }
     }
-    const uint8_t border_color = registers_[kEC];
-    if (y_ < min_y_ || y_ >= max_y_) {
-        for (int last_x = std::min(visible_width_, x_ + 8); x_ < last_x; x_++, pixel_++) {
-            *pixel_ = border_color;
+    return dma;
+}
+
+// Computes the addresses of the video matrix, the glyphs and the bitmap in the VIC bank.
+void VicII::UpdateBases() {
+    screen_base_ = (registers_[kMP] & 0xf0u) << 6u;
+    char_rom_base_ = (registers_[kMP] & 0x0eu) << 10u;
+    bitmap_base_ = (registers_[kMP] & 0x08u) << 10u;
+}
+
+// Builds the list of the sprites fetched by the DMA in priority order, expanding their rows into
+// pixel masks. Their foreground masks are computed at the end of the line.
+void VicII::LatchSprites(uint8_t dma) {
+    const uint16_t pointers = screen_base_ + 0x3f8u;
+    int count = 0;
+    for (int index = 0; index < 8; index++) {
+        const uint8_t bit = 1u << index;
+        if (!(dma & bit)) {
+            continue;
         }
-    } else {
-        for (int last_x = std::min(visible_width_, x_ + 8); x_ < last_x; x_++, pixel_++) {
-            if (x_ < min_x_ || x_ >= max_x_) {
-                *pixel_ = border_color;
-            } else {
-                *pixel_ = RenderScreenPixel();
+        int row = raster_ - (registers_[kM0Y + index * 2] + 1);
+        if (registers_[kMxYE] & bit) {
+            row /= 2;
+        }
+        const uint16_t address = bus_->VicRead(pointers + index) * 64u + row * 3;
+        const uint32_t data = (bus_->VicRead(address) << 16u) |
+                              (bus_->VicRead(address + 1) << 8u) |
+                              bus_->VicRead(address + 2);
+        if (data == 0) {
+            continue;
+        }
+
+        // The planes hold the pixels of the MM0, sprite and MM1 colors.
+        uint64_t planes[3];
+        if (registers_[kMxMC] & bit) {
+            const uint32_t high = (data >> 1u) & 0x555555u;
+            const uint32_t low = data & 0x555555u;
+            planes[0] = (low & ~high) * 3u;
+            planes[1] = (high & ~low) * 3u;
+            planes[2] = (high & low) * 3u;
+        } else {
+            planes[0] = 0;
+            planes[1] = data;
+            planes[2] = 0;
+        }
+        int shift = 40;
+        if (registers_[kMxXE] & bit) {
+            for (uint64_t& plane : planes) {
+                plane = ExpandSpriteRow(uint32_t(plane));
             }
+            shift = 16;
+        }
+
+        VicSprite& sprite = sprites_[count++];
+        sprite.index = index;
+        int x = registers_[kM0X + index * 2] | (((registers_[kMxX] >> index) & 1u) << 8u);
+        if (x >= 0x1f8) {
+            x -= 0x200;
         }
+        sprite.x = min_x_ - 24 + x;
+        for (int plane = 0; plane < 3; plane++) {
+            sprite.planes[plane] = planes[plane] << shift;
+        }
+        sprite.mask = sprite.planes[0] | sprite.planes[1] | sprite.planes[2];
     }
-    return 0;
+    sprite_count_ = count;
 }
 
-uint8_t VicII::RenderScreenPixel() {
-    const int screen_x = (x_ - min_x_);
-    const int char_x = screen_x / 8;
-    const uint8_t ch = char_line_[char_x];
-    const uint8_t bits = bus_->VicRead(char_rom_base_ + ch * 8 + char_row_);
-    const uint8_t mask = 0x80u >> (screen_x & 0x07u);
-    if (bits & mask) {
-        return color_line_[char_x];
-    } else {
-        return registers_[kB0C] & 0x0fu;
+// ANDs the pixel masks of the sprite pairs and of the sprites and the graphics foreground.
+void VicII::DetectCollisions(const VicSprite* sprites, int count) {
+    uint8_t sprite_collisions = 0;
+    uint8_t background_collisions = 0;
+    for (int i = 0; i < count; i++) {
+        const VicSprite& sprite = sprites[i];
+        for (int j = i + 1; j < count; j++) {
+            const VicSprite& other = sprites[j];
+            const int dx = other.x - sprite.x;
+            const bool overlap = dx >= 0 ?
+                dx < 64 && (sprite.mask & (other.mask >> dx)) :
+                dx > -64 && (other.mask & (sprite.mask >> -dx));
+            if (overlap) {
+                sprite_collisions |= (1u << sprite.index) | (1u << other.index);
+            }
+        }
+        if (sprite.mask & sprite.foreground) {
+            background_collisions |= 1u << sprite.index;
+        }
+    }
+    // Only the first collision after reading the register raises an interrupt.
+    if (sprite_collisions) {
+        if (!registers_[kMxM]) {
+            RaiseIrq(kIMMC);
+        }
+        registers_[kMxM] |= sprite_collisions;
+    }
+    if (background_collisions) {
+        if (!registers_[kMxD]) {
+            RaiseIrq(kIMBC);
+        }
+        registers_[kMxD] |= background_collisions;
+    }
+}
+
+// Fetches the glyph row or the bitmap byte of a cell in the current graphics mode.
+uint8_t VicII::FetchGraphics(int cell) {
+    const uint8_t ctrl1 = registers_[kCTRL1];
+    if (ctrl1 & kBMM) {
+        return bus_->VicRead(bitmap_base_ + (((video_base_ + cell) * 8 + char_row_) & 0x1fffu));
+    }
+    const uint8_t code = char_line_[cell];
+    const uint8_t glyph = (ctrl1 & kECM) ? code & 0x3fu : code;
+    return bus_->VicRead(char_rom_base_ + glyph * 8 + char_row_);
+}
+
+// Fetches the foreground pixels of a cell. In multicolor cells the 10 and 11 pairs are the
+// foreground.
+uint8_t VicII::GetForeground(int cell) {
+    if (!display_) {
+        return 0;
+    }
+    uint8_t bits = FetchGraphics(cell);
+    bool multicolor = registers_[kCTRL2] & kMCM;
+    if (!(registers_[kCTRL1] & kBMM)) {
+        multicolor = multicolor && (color_line_[cell] & 0x08u);
+    }
+    if (multicolor) {
+        bits &= 0xaau;
+        bits |= bits >> 1u;
+    }
+    return bits;
+}
+
+// Returns the 64 foreground pixels from x, the first pixel in the highest bit.
+uint64_t VicII::GetForegroundMask(int x) {
+    const int offset = x - scroll_x_;
+    const int first = offset >= 0 ? offset / 8 : -((7 - offset) / 8);
+    uint64_t mask = 0;
+    for (int cell = std::max(first, 0); cell <= std::min(first + 8, kScreenCells - 1); cell++) {
+        const int position = 56 - (cell * 8 - offset);
+        const uint64_t bits = GetForeground(cell);
+        mask |= position >= 0 ? bits << position : bits >> -position;
+    }
+    return mask;
+}
+
+void VicII::RaiseIrq(uint8_t flag) {
+    registers_[kIR] |= flag;
+    if (registers_[kIR] & registers_[kIE] & 0xfu) {
+        registers_[kIR] |= kIRQ;
+        bus_->SetIrq(true);
     }
 }
 
@@ -216,6 +482,11 @@ void VicII::WrRc(uint16_t, uint8_t data) {
     raster_irq_ = (raster_irq_ & 0x100u) | data;
 }
 
+void VicII::WrMp(uint16_t address, uint8_t data) {
+    registers_[address] = data;
+    UpdateBases();
+}
+
 void VicII::WrIr(uint16_t address, uint8_t data) {
     uint8_t result = registers_[kIR] & ~data & 0x0fu;
     if (!(result & 0x0fu)) {
@@ -319,7 +590,7 @@ const VicII::WriteFunction VicII::kWriteTable[64] = {
     &VicII::WrReg,  // 0x15 MxE
     &VicII::WrReg,  // 0x16 CTRL2
     &VicII::WrReg,  // 0x17 MxYE
-    &VicII::WrReg,  // 0x18 MP
+    &VicII::WrMp,   // 0x18 MP
     &VicII::WrIr,   // 0x19 IR
     &VicII::WrReg,  // 0x1a IE
     &VicII::WrReg,  // 0x1b MxDP
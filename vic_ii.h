@@ -23,15 +23,19 @@ CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 #include <cstdint>
 
 #include "frame_buffer.h"
+#include "rasterizer.h"
 
 namespace chico {
 
 class Config;
 class Bus;
+class StateReader;
+class StateWriter;
 
 class VicII final {
 public:
-    VicII(const Config& config_, Bus* bus);
+    VicII(const Config& config_, Bus* bus, Rasterizer* rasterizer);
+    VicII(Bus* bus, Rasterizer* rasterizer, const VicII& other);
 
     uint8_t Read(uint16_t address) {
         const uint16_t ea = address & 0x3fu;
@@ -39,23 +43,64 @@ public:
         return value;
     }
     void Write(uint16_t address, uint8_t data) {
+        Sync();
         const uint16_t ea = address & 0x3fu;
         (this->*kWriteTable[ea])(ea, data);
+        if (record_ != nullptr && IsDisplayRegister(ea)) {
+            LogWrite(ea);
+        }
     }
 
     void Reset();
-    void BeginLine(int line, uint8_t* line_buffer);
-    int CycleOne(int cycle, uint8_t* line_buffer);
+    void BeginLine(int line, FrameBuffer* frame_buffer);
+    // Detects the collisions of the sprites latched at the start of the line and hands the record
+    // of a displayed line to the rasterizer.
+    void EndLine();
+    // Returns the cycles the CPU is stopped for by the stall windows started by the cycle. A window
+    // the CPU reaches late stops it only for its remaining cycles, a window already over not at all.
+    int TakeStalls(int cycle) {
+        int stall_cycles = 0;
+        while (stalls_[next_stall_].cycle <= cycle) {
+            const int end = stalls_[next_stall_].cycle + stalls_[next_stall_].cycles;
+            if (end > cycle) {
+                stall_cycles += end - cycle;
+                cycle = end;
+            }
+            next_stall_ += 1;
+        }
+        return stall_cycles;
+    }
+    // Sets the cycle of the next CPU instruction, its writes become visible from that cycle.
+    void SetCycle(int cycle) { cycle_ = cycle; }
+    // Fetches the graphics of the line up to the current cycle, before a write changes what the
+    // VIC displays. The bytes are fetched only on demand instead of every cycle.
+    void Sync() {
+        if (record_ != nullptr) {
+            FetchTo(GetBeamX());
+        }
+    }
+
+    void SaveState(StateWriter* writer) const;
+    void LoadState(StateReader* reader);
 
 private:
     using ReadFunction = uint8_t (VicII::*)(uint16_t address);
     using WriteFunction = void (VicII::*)(uint16_t address, uint8_t data);
 
+    // Cycles of the line the CPU is stopped for by a bad line or sprite DMA.
+    struct Stall {
+        int cycle;
+        int cycles;
+    };
+
+    static constexpr int kMaxStalls = 8;
+
     static const ReadFunction kReadTable[64];
     static const WriteFunction kWriteTable[64];
 
     const Config &config_;
     Bus* bus_;
+    Rasterizer* rasterizer_;
     uint8_t registers_[64];
     int raster_irq_;
 
@@ -63,9 +108,11 @@ private:
     int visible_height_;
     int screen_width_;
     int screen_height_;
-    uint8_t* pixel_;
-    int x_;
+    VicLine* record_;
     int y_;
+    // The raster line in the VIC's own numbering, $D012 and the raster interrupt compare use it.
+    // Line y_ of the frame buffer is raster line y_ - min_y_ + 0x33.
+    int raster_;
     int min_x_;
     int max_x_;
     int min_y_;
@@ -73,9 +120,40 @@ private:
     uint8_t char_line_[40];
     uint8_t color_line_[40];
     int char_row_;
+    uint16_t screen_base_;
     uint16_t char_rom_base_;
-
-    uint8_t RenderScreenPixel();
+    uint16_t bitmap_base_;
+    int video_base_;
+    bool display_;
+    bool display_enabled_;
+    bool vertical_border_;
+    int left_border_;
+    int right_border_;
+    int scroll_x_;
+    int next_cell_;
+    int cycle_;
+    Stall stalls_[kMaxStalls + 1];
+    int next_stall_;
+    // The sprites fetched by the DMA of the line, latched with the stalls at its start.
+    VicSprite sprites_[8];
+    int sprite_count_;
+
+    void UpdateStalls(bool bad_line, uint8_t dma);
+    uint8_t GetSpriteDma(int vic_line);
+    void UpdateBases();
+    // The beam is 8 pixels further every cycle, the pixels of the current cycle are included.
+    int GetBeamX() const {
+        const int x = (cycle_ + 1) * 8;
+        return x < visible_width_ ? x : visible_width_;
+    }
+    void FetchTo(int last_x);
+    void LogWrite(uint16_t address);
+    void LatchSprites(uint8_t dma);
+    void DetectCollisions(const VicSprite* sprites, int count);
+    uint8_t FetchGraphics(int cell);
+    uint8_t GetForeground(int cell);
+    uint64_t GetForegroundMask(int x);
+    void RaiseIrq(uint8_t flag);
 
     uint8_t RdReg(uint16_t address);
     uint8_t RdCtrl2(uint16_t address);
@@ -87,6 +165,7 @@ private:
     void WrReg(uint16_t address, uint8_t data);
     void WrCtrl1(uint16_t address, uint8_t data);
     void WrRc(uint16_t address, uint8_t data);
+    void WrMp(uint16_t address, uint8_t data);
     void WrIr(uint16_t address, uint8_t data);
     void WrIe(uint16_t address, uint8_t data);
     void WrNil(uint16_t address, uint8_t data);
@@ -0,0 +1,105 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CHICO_VIC_REGISTERS_H
+#define CHICO_VIC_REGISTERS_H
+
+#include <cstdint>
+
+namespace chico {
+
+constexpr uint8_t kIRQ  = 0x80u;
+constexpr uint8_t kILP  = 0x08u;
+constexpr uint8_t kIMMC = 0x04u;
+constexpr uint8_t kIMBC = 0x02u;
+constexpr uint8_t kIRST = 0x01u;
+
+constexpr uint8_t kELP  = 0x80u;
+constexpr uint8_t kEMMC = 0x04u;
+constexpr uint8_t kEMBC = 0x02u;
+constexpr uint8_t kERST = 0x01u;
+
+constexpr uint8_t kECM  = 0x40u;
+constexpr uint8_t kBMM  = 0x20u;
+constexpr uint8_t kDEN  = 0x10u;
+constexpr uint8_t kRSEL = 0x08u;
+constexpr uint8_t kMCM  = 0x10u;
+constexpr uint8_t kCSEL = 0x08u;
+
+constexpr int kM0X      = 0x00;
+constexpr int kM0Y      = 0x01;
+// constexpr int kM1X      = 0x02;
+// constexpr int kM1Y      = 0x03;
+// constexpr int kM2X      = 0x04;
+// constexpr int kM2Y      = 0x05;
+// constexpr int kM3X      = 0x06;
+// constexpr int kM3Y      = 0x07;
+// constexpr int kM4X      = 0x08;
+// constexpr int kM4Y      = 0x09;
+// constexpr int kM5X      = 0x0a;
+// constexpr int kM5Y      = 0x0b;
+// constexpr int kM6X      = 0x0c;
+// constexpr int kM6Y      = 0x0d;
+// constexpr int kM7X      = 0x0e;
+// constexpr int kM7Y      = 0x0f;
+constexpr int kMxX      = 0x10;
+constexpr int kCTRL1    = 0x11;
+constexpr int kRC       = 0x12;
+// constexpr int kLPX      = 0x13;
+// constexpr int kLPY      = 0x14;
+constexpr int kMxE      = 0x15;
+constexpr int kCTRL2    = 0x16;
+constexpr int kMxYE     = 0x17;
+constexpr int kMP       = 0x18;
+constexpr int kIR       = 0x19;
+constexpr int kIE       = 0x1a;
+constexpr int kMxDP     = 0x1b;
+constexpr int kMxMC     = 0x1c;
+constexpr int kMxXE     = 0x1d;
+constexpr int kMxM      = 0x1e;
+constexpr int kMxD      = 0x1f;
+constexpr int kEC       = 0x20;
+constexpr int kB0C      = 0x21;
+constexpr int kB1C      = 0x22;
+constexpr int kB2C      = 0x23;
+constexpr int kB3C      = 0x24;
+constexpr int kMM0      = 0x25;
+constexpr int kMM1      = 0x26;
+constexpr int kM0C      = 0x27;
+// constexpr int kM1C      = 0x28;
+// constexpr int kM2C      = 0x29;
+// constexpr int kM3C      = 0x2a;
+// constexpr int kM4C      = 0x2b;
+// constexpr int kM5C      = 0x2c;
+// constexpr int kM6C      = 0x2d;
+// constexpr int kM7C      = 0x2e;
+
+// The registers up to M7C, the rest of the 64 are unused.
+constexpr int kVicRegisterCount = 0x2f;
+constexpr int kScreenCells = 40;
+
+// The registers the pixels of a line depend on, the rest only affect the VIC timing.
+constexpr bool IsDisplayRegister(int address) {
+    return address == kCTRL1 || address == kCTRL2 || address == kMxDP ||
+           (address >= kEC && address < kVicRegisterCount);
+}
+
+}  // namespace chico
+
+#endif  // CHICO_VIC_REGISTERS_H
@@ -0,0 +1,162 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#include "zygote.h"
+
+#include <cerrno>
+#include <climits>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "boot_cache.h"
+#include "config.h"
+#include "logging.h"
+#include "machine.h"
+
+namespace chico {
+
+Zygote::Zygote(const Config& config, Machine* machine)
+    :   config_(config),
+        machine_(machine) {}
+
+void Zygote::Boot() {
+    frame_buffer_.Reset(config_.GetVisiblePixels(), config_.GetVisibleLines());
+    machine_->Reset();
+    if (!config_.GetBootCache().empty()) {
+        BootCache boot_cache(config_, config_.GetBootCache());
+        boot_cache.Boot(machine_, &frame_buffer_);
+    } else if (!machine_->RunUntilReady(&frame_buffer_, Machine::kMaxBootFrames)) {
+        Log(Warning) << "READY prompt not reached in " << Machine::kMaxBootFrames << " frames";
+    }
+}
+
+void Zygote::Serve(const char* socket_path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (strlen(socket_path) >= sizeof(address.sun_path)) {
+        Log(Fatal) << "socket path too long: " << socket_path;
+    }
+    strcpy(address.sun_path, socket_path);
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        Log(Fatal) << "can't create socket: " << strerror(errno);
+    }
+    unlink(socket_path);
+    if (bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(listener, SOMAXCONN) < 0) {
+        Log(Fatal) << "can't listen on " << socket_path << ": " << strerror(errno);
+    }
+    // Finished jobs are reaped automatically.
+    signal(SIGCHLD, SIG_IGN);
+    Log(Info) << "zygote listening on " << socket_path;
+    for (;;) {
+        const int connection = accept(listener, nullptr, nullptr);
+        if (connection < 0) {
+            if (errno != EINTR) {
+                Log(Error) << "accept failed: " << strerror(errno);
+            }
+            continue;
+        }
+        const pid_t pid = fork();
+        if (pid == 0) {
+            close(listener);
+            RunJob(connection);
+            close(connection);
+            _exit(0);
+        }
+        if (pid < 0) {
+            Log(Error) << "fork failed: " << strerror(errno);
+        }
+        close(connection);
+    }
+}
+
+void Zygote::RunJob(int connection) {
+    int frames;
+    if (!ReadRequest(connection, &frames)) {
+        Log(Error) << "invalid job request";
+        static const char kError[] = "error: expected a non-negative number of frames\n";
+        WriteAll(connection, reinterpret_cast<const uint8_t*>(kError), int(sizeof(kError)) - 1);
+        return;
+    }
+    for (int frame = 0; frame < frames; frame++) {
+        machine_->RunFrame(&frame_buffer_);
+    }
+    for (int line = 0; line < frame_buffer_.height(); line++) {
+        if (!WriteAll(connection, frame_buffer_.line(line), frame_buffer_.width())) {
+            Log(Error) << "can't write job result: " << strerror(errno);
+            return;
+        }
+    }
+}
+
+// Reads the request line, a decimal frame count with nothing else on it, like the counts of the
+// command line options.
+bool Zygote::ReadRequest(int connection, int* frames) {
+    char request[32];
+    int size = 0;
+    bool complete = false;
+    while (size < int(sizeof(request)) - 1) {
+        const ssize_t result = read(connection, request + size, 1);
+        if (result <= 0) {
+            break;
+        }
+        if (request[size] == '\n') {
+            complete = true;
+            break;
+        }
+        size += 1;
+    }
+    // A line that doesn't fit the buffer is too long for any valid count. The rest of it is read
+    // anyway, closing the connection with unread data would reset it before the error answer.
+    if (!complete && size == int(sizeof(request)) - 1) {
+        char c;
+        while (read(connection, &c, 1) == 1 && c != '\n') {
+        }
+        return false;
+    }
+    request[size] = '\0';
+    char* end = nullptr;
+    errno = 0;
+    const long value = strtol(request, &end, 10);
+    if (size == 0 || *end != '\0' || errno == ERANGE || value < 0 || value > INT_MAX) {
+        return false;
+    }
+    *frames = int(value);
+    return true;
+}
+
+bool Zygote::WriteAll(int connection, const uint8_t* data, int size) {
+    while (size > 0) {
+        const ssize_t result = write(connection, data, size);
+        if (result <= 0) {
+            return false;
+        }
+        data += result;
+        size -= int(result);
+    }
+    return true;
+}
+
+}  // namespace chico
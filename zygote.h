@@ -0,0 +1,55 @@
+/*
+Copyright (c) 2020 Gyorgy Abonyi.
+
+Permission is hereby granted, free of charge, to any person obtaining a copy of this software and
+associated documentation files (the "Software"), to deal in the Software without restriction,
+including without limitation the rights to use, copy, modify, merge, publish, distribute,
+sublicense, and/or sell copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all copies or substantial
+portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES
+OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+*/
+
+#ifndef CHICO_ZYGOTE_H
+#define CHICO_ZYGOTE_H
+
+#include "frame_buffer.h"
+
+namespace chico {
+
+class Config;
+class Machine;
+
+// Boots a machine to the READY prompt once, then forks a child process with the booted state for
+// every job request arriving on a local Unix socket.
+//
+// A job request is a text line with the number of frames to run. The child runs them and answers
+// with the indexed pixels of the last frame, visible lines one after the other. A malformed request
+// is answered with a line starting with "error:" instead.
+class Zygote final {
+public:
+    Zygote(const Config& config, Machine* machine);
+
+    void Boot();
+    void Serve(const char* socket_path);
+
+private:
+    const Config& config_;
+    Machine* machine_;
+    FrameBuffer frame_buffer_;
+
+    void RunJob(int connection);
+    bool ReadRequest(int connection, int* frames);
+    bool WriteAll(int connection, const uint8_t* data, int size);
+};
+
+}  // namespace chico
+
+#endif  // CHICO_ZYGOTE_H